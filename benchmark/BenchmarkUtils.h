@@ -0,0 +1,58 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_BENCHMARK_UTILS_H
+#define ARCUS_BENCHMARK_UTILS_H
+
+#include <cstdint>
+#include <string>
+
+#include "PlatformSocket_p.h"
+
+/**
+ * \return A loopback port that no earlier benchmark used.
+ *
+ * Ports are handed out in sequence, so several benchmarks can run after each other
+ * without waiting for ports in TIME_WAIT to become available again.
+ */
+inline uint16_t nextBenchmarkPort()
+{
+    static uint16_t next_port = 47000;
+    return next_port++;
+}
+
+/**
+ * Connect two platform sockets over the loopback interface.
+ *
+ * \return true if the sockets are connected, false if not.
+ */
+inline bool connectPlatformSockets(Arcus::Private::PlatformSocket& server, Arcus::Private::PlatformSocket& client)
+{
+    const std::string address = "127.0.0.1";
+
+    for (int attempt = 0; attempt < 100; ++attempt)
+    {
+        const uint16_t port = nextBenchmarkPort();
+        if (! server.create())
+        {
+            return false;
+        }
+        if (! server.bind(address, port) || ! server.listen(1))
+        {
+            server.close();
+            continue;
+        }
+
+        // The pending connection is queued by the kernel, so it can be accepted afterwards.
+        if (! client.create() || ! client.connect(address, port))
+        {
+            client.close();
+            server.close();
+            return false;
+        }
+        return server.accept();
+    }
+    return false;
+}
+
+#endif // ARCUS_BENCHMARK_UTILS_H
@@ -0,0 +1,120 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <google/protobuf/message.h>
+
+#include "Arcus/MessageTypeStore.h"
+#include "BenchmarkMessages.pb.h"
+
+namespace
+{
+// About the size of a layer of a sliced model.
+constexpr int POLYGONS_PER_LAYER = 200;
+constexpr int POINTS_PER_POLYGON = 64;
+
+std::string serializedLayer()
+{
+    arcus::benchmark::Layer layer;
+    layer.set_id(42);
+    layer.set_height(8.4f);
+    layer.set_thickness(0.2f);
+    for (int i = 0; i < POLYGONS_PER_LAYER; ++i)
+    {
+        arcus::benchmark::Polygon* polygon = layer.add_polygons();
+        polygon->set_type(arcus::benchmark::Polygon::INSET_X);
+        polygon->set_points(std::string(POINTS_PER_POLYGON * 2 * sizeof(float), static_cast<char>(i)));
+        polygon->set_line_width(0.4f);
+        polygon->set_line_thickness(0.2f);
+        polygon->set_line_feedrate(60.0f);
+    }
+    return layer.SerializeAsString();
+}
+
+// Register the protocol the way applications do, from the protocol file at runtime.
+std::unique_ptr<Arcus::MessageTypeStore> loadStore(bool use_generated_types)
+{
+    auto store = std::make_unique<Arcus::MessageTypeStore>();
+    store->setUseGeneratedTypes(use_generated_types);
+    if (! store->registerAllMessageTypes(ARCUS_BENCHMARK_PROTO))
+    {
+        return nullptr;
+    }
+    store->freeze();
+    return store;
+}
+
+const char* pathLabel(bool use_generated_types)
+{
+    return use_generated_types ? "generated" : "dynamic";
+}
+} // namespace
+
+// Load the protocol file and prepare it for use, the setup cost of a socket with its own store.
+static void BM_LoadProtocol(benchmark::State& state)
+{
+    const bool use_generated_types = state.range(0) != 0;
+    for (auto _ : state)
+    {
+        auto store = loadStore(use_generated_types);
+        if (! store)
+        {
+            state.SkipWithError("Could not load " ARCUS_BENCHMARK_PROTO);
+            return;
+        }
+        benchmark::DoNotOptimize(store);
+    }
+    state.SetLabel(pathLabel(use_generated_types));
+}
+BENCHMARK(BM_LoadProtocol)->Arg(0)->Arg(1);
+
+static void BM_ParseLoadedType(benchmark::State& state)
+{
+    const bool use_generated_types = state.range(0) != 0;
+    auto store = loadStore(use_generated_types);
+    if (! store)
+    {
+        state.SkipWithError("Could not load " ARCUS_BENCHMARK_PROTO);
+        return;
+    }
+
+    const std::string data = serializedLayer();
+    const uint32_t type_id = Arcus::typeId("arcus.benchmark.Layer");
+    for (auto _ : state)
+    {
+        Arcus::MessagePtr message = store->createMessage(type_id);
+        message->ParseFromString(data);
+        benchmark::DoNotOptimize(message);
+    }
+    state.SetLabel(pathLabel(use_generated_types));
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_ParseLoadedType)->Arg(0)->Arg(1);
+
+static void BM_SerializeLoadedType(benchmark::State& state)
+{
+    const bool use_generated_types = state.range(0) != 0;
+    auto store = loadStore(use_generated_types);
+    if (! store)
+    {
+        state.SkipWithError("Could not load " ARCUS_BENCHMARK_PROTO);
+        return;
+    }
+
+    const std::string data = serializedLayer();
+    Arcus::MessagePtr message = store->createMessage(Arcus::typeId("arcus.benchmark.Layer"));
+    message->ParseFromString(data);
+
+    std::string output;
+    for (auto _ : state)
+    {
+        message->SerializeToString(&output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetLabel(pathLabel(use_generated_types));
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_SerializeLoadedType)->Arg(0)->Arg(1);
@@ -0,0 +1,182 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include "BenchmarkUtils.h"
+#include "PlatformSocket_p.h"
+
+using namespace Arcus::Private;
+
+namespace
+{
+constexpr std::size_t FRAMES_PER_BATCH = 64;
+
+// A loopback connection with a thread on the receiving end that discards everything.
+class DrainedConnection
+{
+public:
+    DrainedConnection()
+    {
+        valid = connectPlatformSockets(server, client);
+        if (valid)
+        {
+            server.setReceiveTimeout(100);
+            receiver = std::thread(
+                [this]()
+                {
+                    std::vector<char> buffer(1 << 16);
+                    while (! stop)
+                    {
+                        server.readBytes(buffer.size(), buffer.data());
+                    }
+                });
+        }
+    }
+
+    ~DrainedConnection()
+    {
+        stop = true;
+        client.shutdown(PlatformSocket::ShutdownDirection::ShutdownBoth);
+        if (receiver.joinable())
+        {
+            receiver.join();
+        }
+        client.close();
+        server.close();
+    }
+
+    PlatformSocket server;
+    PlatformSocket client;
+    bool valid = false;
+
+private:
+    std::atomic<bool> stop{ false };
+    std::thread receiver;
+};
+
+// Build the frames for a batch of messages of a certain payload size.
+void buildBatch(std::size_t payload_size, std::vector<std::array<uint32_t, 3>>& headers, std::string& payload)
+{
+    headers.assign(FRAMES_PER_BATCH, { htonl(0x2BAD0100), htonl(static_cast<uint32_t>(payload_size)), htonl(0x12345678) });
+    payload.assign(payload_size, 'x');
+}
+
+void reportBatch(benchmark::State& state, std::size_t payload_size, double system_calls_per_batch)
+{
+    state.SetItemsProcessed(state.iterations() * FRAMES_PER_BATCH);
+    state.SetBytesProcessed(state.iterations() * FRAMES_PER_BATCH * (payload_size + 12));
+    state.counters["syscalls_per_frame"] = system_calls_per_batch / FRAMES_PER_BATCH;
+}
+} // namespace
+
+// The way frames were written originally: three integers and the payload, each with its own send().
+static void BM_WriteFramesSeparately(benchmark::State& state)
+{
+    const std::size_t payload_size = static_cast<std::size_t>(state.range(0));
+    DrainedConnection connection;
+    if (! connection.valid)
+    {
+        state.SkipWithError("Could not set up a loopback connection");
+        return;
+    }
+
+    std::string payload(payload_size, 'x');
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < FRAMES_PER_BATCH; ++i)
+        {
+            connection.client.writeUInt32(0x2BAD0100);
+            connection.client.writeUInt32(static_cast<uint32_t>(payload_size));
+            connection.client.writeUInt32(0x12345678);
+            connection.client.writeBytes(payload.size(), payload.data());
+        }
+    }
+
+    reportBatch(state, payload_size, 4.0 * FRAMES_PER_BATCH);
+}
+BENCHMARK(BM_WriteFramesSeparately)->RangeMultiplier(16)->Range(64, 1 << 20)->UseRealTime();
+
+// A whole batch of frames written through a single vectored send.
+static void BM_WriteFramesVectored(benchmark::State& state)
+{
+    const std::size_t payload_size = static_cast<std::size_t>(state.range(0));
+    DrainedConnection connection;
+    if (! connection.valid)
+    {
+        state.SkipWithError("Could not set up a loopback connection");
+        return;
+    }
+    connection.client.setUseIoUring(false);
+
+    std::vector<std::array<uint32_t, 3>> headers;
+    std::string payload;
+    buildBatch(payload_size, headers, payload);
+
+    std::vector<WriteBuffer> buffers;
+    for (const auto& header : headers)
+    {
+        buffers.push_back({ reinterpret_cast<const char*>(header.data()), sizeof(header) });
+        buffers.push_back({ payload.data(), payload.size() });
+    }
+
+    for (auto _ : state)
+    {
+        connection.client.writeBuffers(buffers.data(), buffers.size());
+    }
+
+    reportBatch(state, payload_size, 1.0);
+}
+BENCHMARK(BM_WriteFramesVectored)->RangeMultiplier(16)->Range(64, 1 << 20)->UseRealTime();
+
+// The same batch submitted through io_uring, only meaningful when built with ENABLE_IO_URING.
+static void BM_WriteFramesIoUring(benchmark::State& state)
+{
+    const std::size_t payload_size = static_cast<std::size_t>(state.range(0));
+    DrainedConnection connection;
+    if (! connection.valid)
+    {
+        state.SkipWithError("Could not set up a loopback connection");
+        return;
+    }
+
+    std::vector<std::array<uint32_t, 3>> headers;
+    std::string payload;
+    buildBatch(payload_size, headers, payload);
+
+    std::vector<WriteBuffer> buffers;
+    for (const auto& header : headers)
+    {
+        buffers.push_back({ reinterpret_cast<const char*>(header.data()), sizeof(header) });
+        buffers.push_back({ payload.data(), payload.size() });
+    }
+
+    // The first write sets up the ring, after which we know whether it is actually in use.
+    connection.client.setUseIoUring(true);
+    connection.client.writeBuffers(buffers.data(), buffers.size());
+    if (! connection.client.isUsingIoUring())
+    {
+        state.SkipWithError("io_uring is not available, build with ENABLE_IO_URING on a supporting kernel");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        connection.client.writeBuffers(buffers.data(), buffers.size());
+    }
+
+    reportBatch(state, payload_size, 1.0);
+}
+BENCHMARK(BM_WriteFramesIoUring)->RangeMultiplier(16)->Range(64, 1 << 20)->UseRealTime();
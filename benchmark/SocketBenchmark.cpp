@@ -0,0 +1,397 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include "Arcus/MessageTypeStore.h"
+#include "Arcus/Socket.h"
+#include "BenchmarkMessages.pb.h"
+#include "BenchmarkUtils.h"
+#include "PlatformSocket_p.h"
+
+using namespace Arcus;
+using Arcus::Private::PlatformSocket;
+
+namespace
+{
+constexpr std::size_t MESSAGES_PER_BATCH = 64;
+constexpr uint32_t FRAME_HEADER = 0x2BAD0100;
+
+// Points per polygon for the layers made of polygons, about what a sliced wall has.
+constexpr int POINTS_PER_POLYGON = 64;
+
+// The shape of the messages in the size sweeps.
+enum class Shape
+{
+    Blob = 0, // A layer with a single polygon holding all of the data, cheap to parse.
+    Polygons = 1 // A layer of many small polygons, the way slice data is sent.
+};
+
+/**
+ * Build a layer whose serialized size is close to the given size.
+ */
+std::shared_ptr<arcus::benchmark::Layer> makeLayer(Shape shape, std::size_t size)
+{
+    auto layer = std::make_shared<arcus::benchmark::Layer>();
+    layer->set_id(42);
+    layer->set_height(8.4f);
+    layer->set_thickness(0.2f);
+
+    const std::size_t polygon_size = std::min<std::size_t>(POINTS_PER_POLYGON * 2 * sizeof(float), size);
+    const std::size_t polygon_count = shape == Shape::Blob ? 1 : std::max<std::size_t>(1, size / (polygon_size + 20));
+    for (std::size_t i = 0; i < polygon_count; ++i)
+    {
+        arcus::benchmark::Polygon* polygon = layer->add_polygons();
+        polygon->set_type(arcus::benchmark::Polygon::INSET_X);
+        polygon->set_points(std::string(shape == Shape::Blob ? size : polygon_size, static_cast<char>(i)));
+        polygon->set_line_width(0.4f);
+        polygon->set_line_thickness(0.2f);
+        polygon->set_line_feedrate(60.0f);
+    }
+    return layer;
+}
+
+void appendUInt32(std::string& buffer, uint32_t value)
+{
+    const uint32_t network_value = htonl(value);
+    buffer.append(reinterpret_cast<const char*>(&network_value), sizeof(network_value));
+}
+
+// The frames of a batch of messages as a Socket writes them to the wire.
+std::string encodeBatch(const google::protobuf::Message& message, uint32_t type_id)
+{
+    const std::string payload = message.SerializeAsString();
+    std::string batch;
+    batch.reserve(MESSAGES_PER_BATCH * (payload.size() + 12));
+    for (std::size_t i = 0; i < MESSAGES_PER_BATCH; ++i)
+    {
+        appendUInt32(batch, FRAME_HEADER);
+        appendUInt32(batch, static_cast<uint32_t>(payload.size()));
+        appendUInt32(batch, type_id);
+        batch.append(payload);
+    }
+    return batch;
+}
+
+bool waitForState(const Socket& socket, SocketState state)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (socket.getState() != state)
+    {
+        if (socket.getState() == SocketState::Error || std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Sockets in the benchmarks talk to a bare platform socket, which does not answer the close handshake.
+void configureSocket(Socket& socket)
+{
+    SocketOptions options = socket.getOptions();
+    options.close_timeout = 100;
+    socket.setOptions(options);
+    socket.registerMessageType<arcus::benchmark::Layer>();
+    socket.registerMessageType<arcus::benchmark::Progress>();
+}
+
+// A Socket that sends to a platform socket with a thread on the receiving end that discards everything.
+class SendingConnection
+{
+public:
+    SendingConnection()
+    {
+        configureSocket(socket);
+        for (int attempt = 0; attempt < 100 && ! valid; ++attempt)
+        {
+            const uint16_t port = nextBenchmarkPort();
+            if (! server.create() || ! server.bind("127.0.0.1", port) || ! server.listen(1))
+            {
+                server.close();
+                continue;
+            }
+
+            socket.connect("127.0.0.1", port);
+            valid = server.accept() && waitForState(socket, SocketState::Connected);
+            if (! valid)
+            {
+                return;
+            }
+        }
+
+        server.setReceiveTimeout(100);
+        receiver = std::thread(
+            [this]()
+            {
+                std::vector<char> buffer(1 << 16);
+                while (! stop)
+                {
+                    server.readBytes(buffer.size(), buffer.data());
+                }
+            });
+    }
+
+    ~SendingConnection()
+    {
+        socket.close();
+        stop = true;
+        if (receiver.joinable())
+        {
+            receiver.join();
+        }
+        server.close();
+    }
+
+    Socket socket;
+    PlatformSocket server;
+    bool valid = false;
+
+private:
+    std::atomic<bool> stop{ false };
+    std::thread receiver;
+};
+
+// A Socket that receives what a platform socket writes to it.
+class ReceivingConnection
+{
+public:
+    ReceivingConnection()
+    {
+        for (int attempt = 0; attempt < 100 && ! valid; ++attempt)
+        {
+            const uint16_t port = nextBenchmarkPort();
+            socket = std::make_unique<Socket>();
+            configureSocket(*socket);
+            socket->listen("127.0.0.1", port);
+            if (! waitForState(*socket, SocketState::Listening) && socket->getState() != SocketState::Connected)
+            {
+                continue;
+            }
+
+            valid = client.create() && client.connect("127.0.0.1", port) && waitForState(*socket, SocketState::Connected);
+            if (! valid)
+            {
+                return;
+            }
+        }
+    }
+
+    ~ReceivingConnection()
+    {
+        client.close();
+        if (socket)
+        {
+            socket->close();
+        }
+    }
+
+    std::unique_ptr<Socket> socket;
+    PlatformSocket client;
+    bool valid = false;
+};
+
+void reportBatch(benchmark::State& state, std::size_t message_size)
+{
+    state.SetItemsProcessed(state.iterations() * MESSAGES_PER_BATCH);
+    state.SetBytesProcessed(state.iterations() * MESSAGES_PER_BATCH * (message_size + 12));
+    state.counters["message_size"] = static_cast<double>(message_size);
+}
+
+// Every size in the sweeps, for both shapes of message.
+void sizeSweep(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({ "shape", "size" });
+    benchmark->ArgsProduct({ { static_cast<int64_t>(Shape::Blob), static_cast<int64_t>(Shape::Polygons) }, { 64, 1 << 10, 16 << 10, 256 << 10, 1 << 20 } });
+}
+
+std::unique_ptr<MessageTypeStore> generatedStore()
+{
+    auto store = std::make_unique<MessageTypeStore>();
+    store->registerMessageType<arcus::benchmark::Layer>();
+    store->registerMessageType<arcus::benchmark::Polygon>();
+    store->registerMessageType<arcus::benchmark::Progress>();
+    store->freeze();
+    return store;
+}
+} // namespace
+
+// Serializing messages into frames and writing them, what happens to messages passed to Socket::sendMessage().
+static void BM_EncodeFrames(benchmark::State& state)
+{
+    const auto message = makeLayer(static_cast<Shape>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+    SendingConnection connection;
+    if (! connection.valid)
+    {
+        state.SkipWithError("Could not set up a loopback connection");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < MESSAGES_PER_BATCH - 1; ++i)
+        {
+            connection.socket.sendMessage(message);
+        }
+        // Messages are written in order, so once the last one is written the whole batch is.
+        if (! connection.socket.sendMessage(message, SendCompletion::Written).get().written)
+        {
+            state.SkipWithError("The connection was lost");
+            return;
+        }
+    }
+
+    reportBatch(state, message->ByteSizeLong());
+}
+BENCHMARK(BM_EncodeFrames)->Apply(sizeSweep)->UseRealTime();
+
+// Reading frames from the wire and parsing them into messages, until they are taken from the receive queue.
+static void BM_DecodeFrames(benchmark::State& state)
+{
+    const auto message = makeLayer(static_cast<Shape>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+    const std::string batch = encodeBatch(*message, MessageTypeStore::getMessageTypeId<arcus::benchmark::Layer>());
+    ReceivingConnection connection;
+    if (! connection.valid)
+    {
+        state.SkipWithError("Could not set up a loopback connection");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        // Written from another thread, so large batches do not fill the kernel buffers while nobody takes messages.
+        std::thread writer([&]() { connection.client.writeBytes(batch.size(), batch.data()); });
+        for (std::size_t i = 0; i < MESSAGES_PER_BATCH; ++i)
+        {
+            if (! connection.socket->takeNextMessage())
+            {
+                writer.join();
+                state.SkipWithError("The connection was lost");
+                return;
+            }
+        }
+        writer.join();
+    }
+
+    reportBatch(state, message->ByteSizeLong());
+}
+BENCHMARK(BM_DecodeFrames)->Apply(sizeSweep)->UseRealTime();
+
+// Creating a message for the type of a received frame and parsing its payload, the way the socket does it.
+static void BM_ParseFrame(benchmark::State& state)
+{
+    const auto store = generatedStore();
+    const std::string payload = makeLayer(static_cast<Shape>(state.range(0)), static_cast<std::size_t>(state.range(1)))->SerializeAsString();
+    const uint32_t type_id = MessageTypeStore::getMessageTypeId<arcus::benchmark::Layer>();
+
+    for (auto _ : state)
+    {
+        MessagePtr message = store->createMessage(type_id);
+        google::protobuf::io::ArrayInputStream array(payload.data(), static_cast<int>(payload.size()));
+        google::protobuf::io::CodedInputStream stream(&array);
+        if (! message->ParseFromCodedStream(&stream))
+        {
+            state.SkipWithError("Could not parse the payload");
+            return;
+        }
+        benchmark::DoNotOptimize(message);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_ParseFrame)->Apply(sizeSweep);
+
+// Hashing a type name into the id sent in frames.
+static void BM_TypeIdHash(benchmark::State& state)
+{
+    const std::vector<std::string> names = { "arcus.benchmark.Progress", "arcus.benchmark.Layer", "cura.proto.SlicingFinished", "cura.proto.LayerOptimized" };
+    for (auto _ : state)
+    {
+        for (const std::string& name : names)
+        {
+            benchmark::DoNotOptimize(typeId(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_TypeIdHash);
+
+// Looking up the prototype for the type id of a received frame and creating an empty message from it.
+static void BM_CreateMessage(benchmark::State& state)
+{
+    const auto store = generatedStore();
+    const uint32_t type_id = state.range(0) != 0 ? MessageTypeStore::getMessageTypeId<arcus::benchmark::Layer>() : MessageTypeStore::getMessageTypeId<arcus::benchmark::Progress>();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(store->createMessage(type_id));
+    }
+    state.SetLabel(state.range(0) != 0 ? "Layer" : "Progress");
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CreateMessage)->Arg(0)->Arg(1);
+
+// Looking up the type id of a message that is about to be sent.
+static void BM_GetMessageTypeId(benchmark::State& state)
+{
+    const auto store = generatedStore();
+    const MessagePtr message = std::make_shared<arcus::benchmark::Progress>();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(store->getMessageTypeId(message));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetMessageTypeId);
+
+// Passing messages through the send queue of one socket and the receive queue of another, without a wire in between.
+static void BM_QueuePushTake(benchmark::State& state)
+{
+    Socket sender;
+    Socket receiver;
+    configureSocket(sender);
+    configureSocket(receiver);
+    sender.connectInProcess(&receiver);
+    if (! waitForState(sender, SocketState::Connected) || ! waitForState(receiver, SocketState::Connected))
+    {
+        state.SkipWithError("Could not connect the sockets");
+        return;
+    }
+
+    const auto message = std::make_shared<arcus::benchmark::Progress>();
+    const std::size_t batch_size = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < batch_size; ++i)
+        {
+            sender.sendMessage(message);
+        }
+        for (std::size_t i = 0; i < batch_size; ++i)
+        {
+            benchmark::DoNotOptimize(receiver.takeNextMessage());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+
+    sender.close();
+    receiver.close();
+}
+BENCHMARK(BM_QueuePushTake)->Arg(1)->Arg(64)->Arg(1024)->UseRealTime();
@@ -0,0 +1,64 @@
+# Copyright (c) 2025 UltiMaker
+# libArcus is released under the terms of the LGPLv3 or higher.
+
+# arcus_embed_descriptor_set(<target> NAME <name> PROTO <file> [IMPORT_DIRS <dir>...])
+#
+# Compiles the protocol file and the files it imports into a binary descriptor set with
+# protoc at build time and embeds it in <target>. The generated header <name>.h declares
+#
+#     extern const char <name>[];
+#     extern const std::size_t <name>_size;
+#
+# which can be passed to Socket::registerAllMessageTypesFromDescriptorSet(), so the
+# protocol files do not have to be shipped or parsed at runtime. That registers the
+# message types of <file>, like registerAllMessageTypes() would.
+
+set(_ARCUS_EMBED_FILE_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/ArcusEmbedFile.cmake")
+
+function(arcus_embed_descriptor_set target)
+    cmake_parse_arguments(ARG "" "NAME;PROTO" "IMPORT_DIRS" ${ARGN})
+    if(NOT ARG_NAME OR NOT ARG_PROTO)
+        message(FATAL_ERROR "arcus_embed_descriptor_set() needs a NAME and a PROTO file")
+    endif()
+
+    if(TARGET protobuf::protoc)
+        set(_protoc $<TARGET_FILE:protobuf::protoc>)
+    else()
+        find_program(ARCUS_PROTOC_EXECUTABLE protoc REQUIRED)
+        set(_protoc ${ARCUS_PROTOC_EXECUTABLE})
+    endif()
+
+    set(_import_args)
+    foreach(_dir ${ARG_IMPORT_DIRS})
+        get_filename_component(_dir "${_dir}" ABSOLUTE)
+        list(APPEND _import_args "-I${_dir}")
+    endforeach()
+    get_filename_component(_proto "${ARG_PROTO}" ABSOLUTE)
+    get_filename_component(_proto_dir "${_proto}" DIRECTORY)
+    list(APPEND _import_args "-I${_proto_dir}")
+    list(REMOVE_DUPLICATES _import_args)
+
+    set(_output_dir "${CMAKE_CURRENT_BINARY_DIR}/arcus_descriptor_sets")
+    set(_descriptor_set "${_output_dir}/${ARG_NAME}.desc")
+    set(_source "${_output_dir}/${ARG_NAME}.cpp")
+    set(_header "${_output_dir}/${ARG_NAME}.h")
+
+    add_custom_command(
+        OUTPUT "${_descriptor_set}"
+        COMMAND ${CMAKE_COMMAND} -E make_directory "${_output_dir}"
+        COMMAND ${_protoc} ${_import_args} --include_imports "--descriptor_set_out=${_descriptor_set}" "${_proto}"
+        DEPENDS "${_proto}"
+        COMMENT "Compiling descriptor set ${ARG_NAME}"
+        VERBATIM
+    )
+    add_custom_command(
+        OUTPUT "${_source}" "${_header}"
+        COMMAND ${CMAKE_COMMAND} -DINPUT=${_descriptor_set} -DNAME=${ARG_NAME} -DSOURCE=${_source} -DHEADER=${_header} -P "${_ARCUS_EMBED_FILE_SCRIPT}"
+        DEPENDS "${_descriptor_set}" "${_ARCUS_EMBED_FILE_SCRIPT}"
+        COMMENT "Embedding descriptor set ${ARG_NAME}"
+        VERBATIM
+    )
+
+    target_sources(${target} PRIVATE "${_source}" "${_header}")
+    target_include_directories(${target} PRIVATE "${_output_dir}")
+endfunction()
@@ -0,0 +1,17 @@
+# Copyright (c) 2025 UltiMaker
+# libArcus is released under the terms of the LGPLv3 or higher.
+
+# Script mode helper for arcus_embed_descriptor_set(), writes the contents of INPUT as a
+# char array called NAME to SOURCE and its declaration to HEADER.
+
+file(READ "${INPUT}" _contents HEX)
+string(LENGTH "${_contents}" _length)
+math(EXPR _size "${_length} / 2")
+
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," _bytes "${_contents}")
+# CMake regular expressions have no counted repetition, so spell out 16 bytes per line.
+string(REPEAT "[^,]*," 16 _line)
+string(REGEX REPLACE "(${_line})" "\\1\n    " _bytes "${_bytes}")
+
+file(WRITE "${HEADER}" "// Generated from ${INPUT}, do not edit.\n#pragma once\n\n#include <cstddef>\n\nextern const char ${NAME}[];\nextern const std::size_t ${NAME}_size;\n")
+file(WRITE "${SOURCE}" "// Generated from ${INPUT}, do not edit.\n#include \"${NAME}.h\"\n\nextern const char ${NAME}[] = {\n    ${_bytes}\n    '\\0'\n};\nextern const std::size_t ${NAME}_size = ${_size};\n")
@@ -30,10 +30,12 @@ class ArcusConan(ConanFile):
     options = {
         "shared": [True, False],
         "fPIC": [True, False],
+        "enable_io_uring": [True, False],
     }
     default_options = {
         "shared": True,
         "fPIC": True,
+        "enable_io_uring": False,
     }
 
     def init(self):
@@ -66,12 +68,15 @@ class ArcusConan(ConanFile):
         copy(self, "CMakeLists.txt", self.recipe_folder, self.export_sources_folder)
         copy(self, "*", os.path.join(self.recipe_folder, "src"), os.path.join(self.export_sources_folder, "src"))
         copy(self, "*", os.path.join(self.recipe_folder, "include"), os.path.join(self.export_sources_folder, "include"))
+        copy(self, "*.cmake", os.path.join(self.recipe_folder, "cmake"), os.path.join(self.export_sources_folder, "cmake"))
 
     def config_options(self):
         super().config_options()
 
         if self.settings.os == "Windows":
             del self.options.fPIC
+        if self.settings.os != "Linux":
+            del self.options.enable_io_uring
 
     def configure(self):
         super().configure()
@@ -82,6 +87,9 @@ class ArcusConan(ConanFile):
     def layout(self):
         cmake_layout(self)
         self.cpp.package.libs = ["Arcus"]
+        # Makes arcus_embed_descriptor_set() available to consumers after find_package(arcus).
+        self.cpp.package.builddirs = [os.path.join("lib", "cmake", "arcus")]
+        self.cpp.package.set_property("cmake_build_modules", [os.path.join("lib", "cmake", "arcus", "ArcusDescriptorSet.cmake")])
 
         if self.settings.build_type == "Debug":
             self.cpp.package.defines = ["ARCUS_DEBUG"]
@@ -124,6 +132,7 @@ class ArcusConan(ConanFile):
         if is_msvc(self):
             tc.variables["USE_MSVC_RUNTIME_LIBRARY_DLL"] = not is_msvc_static_runtime(self)
         tc.cache_variables["CMAKE_POLICY_DEFAULT_CMP0077"] = "NEW"
+        tc.variables["ENABLE_IO_URING"] = self.options.get_safe("enable_io_uring", False)
         self.setup_cmake_toolchain_sentry(tc)
         tc.generate()
 
@@ -143,8 +152,9 @@ class ArcusConan(ConanFile):
     def package(self):
         copy(self, pattern="LICENSE*", dst="licenses", src=self.source_folder)
         copy(self, pattern="*.h", src=os.path.join(self.source_folder, "include"), dst=os.path.join(self.package_folder, "include"))
+        copy(self, pattern="*.cmake", src=os.path.join(self.source_folder, "cmake"), dst=os.path.join(self.package_folder, "lib", "cmake", "arcus"))
         copy(self, pattern="*.a", src=self.build_folder, dst=os.path.join(self.package_folder, "lib"), keep_path=False)
-        copy(self, pattern="*.so", src=self.build_folder, dst=os.path.join(self.package_folder, "lib"), keep_path=False)
+        copy(self, pattern="*.so*", src=self.build_folder, dst=os.path.join(self.package_folder, "lib"), keep_path=False)
         copy(self, pattern="*.lib", src=self.build_folder, dst=os.path.join(self.package_folder, "lib"), keep_path=False)
         copy(self, pattern="*.dll", src=self.build_folder, dst=os.path.join(self.package_folder, "bin"), keep_path=False)
         copy(self, pattern="*.dylib", src=self.build_folder, dst=os.path.join(self.package_folder, "lib"), keep_path=False)
@@ -0,0 +1,135 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_AWAITABLES_H
+#define ARCUS_AWAITABLES_H
+
+#include <coroutine>
+#include <memory>
+
+#include "Arcus/Types.h"
+
+namespace Arcus
+{
+class Socket;
+
+/**
+ * \brief The result of Socket::receive(), for use with co_await.
+ *
+ * A coroutine awaiting this is suspended until the socket receives a message.
+ * It is resumed by the socket's worker thread, or for an embedded socket by the
+ * thread calling Socket::process(), so no thread is blocked while it waits.
+ *
+ * The result is the received message, or an invalid pointer if the socket is
+ * closed or in the error state.
+ *
+ * \note A coroutine that is suspended on this must not be destroyed before it is resumed.
+ *
+ * \note The coroutine is resumed inline, so it runs on the worker thread or inside
+ * Socket::process() until it suspends again, and the socket does nothing else in the
+ * meantime. Like a SocketListener callback it may send messages and call close(), but
+ * it must not call reset() or destroy the socket, and long work should be handed to a
+ * thread of its own.
+ */
+class ReceiveAwaitable
+{
+public:
+    explicit ReceiveAwaitable(Socket& socket) : _socket(&socket)
+    {
+    }
+
+    bool await_ready()
+    {
+        // Whether a message is available is checked in await_suspend(), under the same lock as registering.
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle);
+    MessagePtr await_resume();
+
+private:
+    // So the socket can hand over the message and resume us.
+    friend class Socket;
+
+    Socket* _socket;
+    MessagePtr _message;
+    std::coroutine_handle<> _handle;
+};
+
+/**
+ * \brief The result of Socket::receive<T>(), for use with co_await.
+ *
+ * Like ReceiveAwaitable, but the message is cast to the expected type. The
+ * result is an invalid pointer if the message received is of another type.
+ */
+template<typename T>
+class TypedReceiveAwaitable
+{
+public:
+    explicit TypedReceiveAwaitable(Socket& socket) : _receive(socket)
+    {
+    }
+
+    bool await_ready()
+    {
+        return _receive.await_ready();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        return _receive.await_suspend(handle);
+    }
+
+    std::shared_ptr<T> await_resume()
+    {
+        return std::dynamic_pointer_cast<T>(_receive.await_resume());
+    }
+
+private:
+    ReceiveAwaitable _receive;
+};
+
+/**
+ * \brief The result of Socket::send(), for use with co_await.
+ *
+ * A coroutine awaiting this is suspended until the message was written, and is
+ * resumed the same way as for ReceiveAwaitable. The result is the receipt of the
+ * message, see Socket::sendMessage(MessagePtr, SendCompletion). If the socket is
+ * already closed, the coroutine is not suspended and the receipt says the message
+ * was not written.
+ *
+ * \note A coroutine that is suspended on this must not be destroyed before it is resumed.
+ *
+ * \note The coroutine is resumed inline, with the same limits as for ReceiveAwaitable.
+ */
+class SendAwaitable
+{
+public:
+    SendAwaitable(Socket& socket, MessagePtr message) : _socket(&socket), _message(message)
+    {
+    }
+
+    bool await_ready()
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle);
+
+    SendReceipt await_resume()
+    {
+        return _receipt;
+    }
+
+private:
+    // So the socket can hand over the receipt and resume us.
+    friend class Socket;
+
+    Socket* _socket;
+    MessagePtr _message;
+    SendReceipt _receipt;
+    std::coroutine_handle<> _handle;
+};
+} // namespace Arcus
+
+#endif // ARCUS_AWAITABLES_H
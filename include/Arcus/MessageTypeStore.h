@@ -4,14 +4,43 @@
 #ifndef ARCUS_MESSAGE_TYPE_STORE_H
 #define ARCUS_MESSAGE_TYPE_STORE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <string_view>
 
 #include "Arcus/Types.h"
 
 namespace Arcus
 {
+/**
+ * Compute the type ID of a message type from its full name, such as "cura.proto.Slice".
+ *
+ * This is the 32-bit FNV-1a hash of the name, as sent along with every message. It can be
+ * evaluated at compile time, for example to switch on the types of received messages.
+ *
+ * \param type_name The fully qualified name of the message type.
+ *
+ * \return The type ID.
+ */
+constexpr uint32_t typeId(std::string_view type_name)
+{
+    uint32_t result = 2166136261u;
+    for (char character : type_name)
+    {
+        result ^= static_cast<uint32_t>(character);
+        result *= 16777619u;
+    }
+    return result;
+}
+
 /**
  * A class to manage the different types of messages that are available.
+ *
+ * Every Socket has a store of its own, but a store can also be built once and shared
+ * by any number of sockets through Socket::setMessageTypeStore(), so the descriptors
+ * and prototypes exist only once. A shared store must not be changed anymore: its
+ * const members are then safe to call from any thread.
  */
 class MessageTypeStore
 {
@@ -56,14 +85,62 @@ public:
     /**
      * Get the type ID of a message.
      *
+     * For registered types this is a lookup by descriptor, other types are hashed by name.
+     *
      * \param message The message to get the type ID of.
      *
      * \return The type id of the message.
      */
-    uint32_t getMessageTypeId(const MessagePtr& message);
+    uint32_t getMessageTypeId(const MessagePtr& message) const;
+
+    /**
+     * Get the type ID of a generated message class.
+     *
+     * The ID is computed only once for each type.
+     *
+     * \return The type id of T.
+     */
+    template<typename T>
+    static uint32_t getMessageTypeId()
+    {
+        static const uint32_t type_id = typeId(T::descriptor()->full_name());
+        return type_id;
+    }
 
     std::string getErrorMessages() const;
 
+    /**
+     * Build compact lookup tables for the registered types.
+     *
+     * Looking up types happens for every message sent or received, while registering only
+     * happens up front. Once frozen, each lookup touches a single slot of a flat table.
+     * Registering another type thaws the store again, until the next call to freeze().
+     *
+     * This also prepares the tables protobuf uses to parse and serialize each type, so the
+     * first message of a type loaded at runtime is not slower than the ones after it.
+     *
+     * Socket calls this when it starts connecting or listening.
+     */
+    void freeze();
+
+    /**
+     * \return true if the lookup tables are built and up to date.
+     */
+    bool isFrozen() const;
+
+    /**
+     * Set whether types loaded at runtime use the generated classes linked into the binary.
+     *
+     * Types registered from protocol files or descriptor sets are normally dynamic messages,
+     * which are a lot slower to parse and serialize than generated code. When a generated
+     * class for the same type exists in the binary and was generated from the same
+     * definition, it is used instead, so received messages can also be cast to it.
+     * This is enabled by default and affects types registered after the call.
+     *
+     * \param use_generated_types false to always use dynamic messages.
+     */
+    void setUseGeneratedTypes(bool use_generated_types);
+
     /**
      * Register a message type.
      *
@@ -72,6 +149,16 @@ public:
      * \return true if registration was successful, false if not.
      */
     bool registerMessageType(const google::protobuf::Message* message_type);
+    /**
+     * Register a generated message class.
+     *
+     * \return true if registration was successful, false if not.
+     */
+    template<typename T>
+    bool registerMessageType()
+    {
+        return registerMessageType(&T::default_instance());
+    }
     /**
      * Register all message types from a Protobuf protocol description file.
      *
@@ -81,10 +168,40 @@ public:
      */
     bool registerAllMessageTypes(const std::string& file_name);
 
+    /**
+     * Register all message types from a precompiled descriptor set.
+     *
+     * A descriptor set is the binary FileDescriptorSet written by
+     * `protoc --include_imports --descriptor_set_out` for one protocol file. Loading it
+     * skips parsing the protocol files, which makes registration a lot faster.
+     *
+     * Like registerAllMessageTypes(), this registers the top-level message types of
+     * that file, which is the last one in the set. The files it imports are only used
+     * to build it.
+     *
+     * \param file_name The path to the descriptor set.
+     *
+     * \return true if registration was successful, false if not.
+     */
+    bool registerAllMessageTypesFromDescriptorSet(const std::string& file_name);
+    /**
+     * Register all message types from a precompiled descriptor set in memory.
+     *
+     * This is meant for descriptor sets embedded in the binary with the
+     * arcus_embed_descriptor_set() CMake function. See the other overload for
+     * the types it registers.
+     *
+     * \param data The serialized FileDescriptorSet.
+     * \param size The size of data in bytes.
+     *
+     * \return true if registration was successful, false if not.
+     */
+    bool registerAllMessageTypesFromDescriptorSet(const char* data, std::size_t size);
+
     /**
      * Dump all message type IDs and type names to stdout.
      */
-    void dumpMessageTypes();
+    void dumpMessageTypes() const;
 
 private:
     class Private;
@@ -0,0 +1,166 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_RPC_CHANNEL_H
+#define ARCUS_RPC_CHANNEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+
+#include "Arcus/Types.h"
+
+namespace Arcus
+{
+class Socket;
+
+/**
+ * How a call made through an RpcChannel ended.
+ */
+enum class CallStatus
+{
+    Replied, ///< The other side replied, the reply is set.
+    TimedOut, ///< No reply arrived before the timeout of the call expired.
+    Cancelled, ///< The call was cancelled, or the channel was destroyed before a reply arrived.
+    Failed ///< The request could not be sent or the connection was lost before a reply arrived.
+};
+
+/**
+ * The outcome of a call made through an RpcChannel.
+ */
+struct CallResult
+{
+    CallStatus status = CallStatus::Failed;
+    MessagePtr reply; ///< The reply, only set if status is CallStatus::Replied.
+};
+
+/**
+ * \brief Request/response calls on top of a Socket.
+ *
+ * Requests and replies are regular messages of types registered with the socket,
+ * sent as frames tagged with a call id. This allows any number of calls to be in
+ * flight at the same time, with replies matched to their requests regardless of
+ * the order in which they arrive. Untagged messages keep going to the receive queue
+ * of the socket, so calls can be mixed with plain messages.
+ *
+ * Both sides need a version of libArcus that supports this, and each side attaches
+ * its own channel to its socket. Calls that are in flight when the socket closes or
+ * loses its connection fail.
+ */
+class RpcChannel
+{
+public:
+    /**
+     * A call that was made, with the id to cancel it by and the future for its result.
+     */
+    struct Call
+    {
+        uint32_t id = 0;
+        std::future<CallResult> result;
+    };
+
+    /**
+     * Called for every request that arrives, from the socket's worker thread.
+     *
+     * Answer the request by passing the call id to reply(), either right away or later
+     * from any thread. Requests arrive while the handler runs, so long running work is
+     * better handed to another thread.
+     */
+    using RequestHandler = std::function<void(uint32_t call_id, const MessagePtr& request)>;
+
+    /**
+     * Attach a channel to a socket.
+     *
+     * A socket can only have one channel at a time. The socket must outlive the channel
+     * or the channel stops working when the socket is destroyed.
+     *
+     * \param socket The socket to make calls through.
+     */
+    explicit RpcChannel(Socket& socket);
+
+    /**
+     * Detach from the socket, cancelling all calls that are still in flight.
+     *
+     * \note This should not be destroyed from within the request handler.
+     */
+    ~RpcChannel();
+
+    /**
+     * \return false if the socket already had a channel, in which case this channel does nothing.
+     */
+    bool isAttached() const;
+
+    /**
+     * Send a request and wait for the reply asynchronously.
+     *
+     * \param request The request to send. Its type must be registered with the socket.
+     * \param timeout How long to wait for the reply, or 0 to wait until the call is
+     *                cancelled or the connection is lost.
+     *
+     * \return The call, whose result becomes ready once it is replied to, timed out,
+     *         cancelled or failed.
+     */
+    Call call(MessagePtr request, std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+    /**
+     * Stop waiting for the reply to a call.
+     *
+     * The result of the call becomes ready with CallStatus::Cancelled and a reply that
+     * still arrives is ignored.
+     *
+     * \param call_id The id of the call to cancel.
+     *
+     * \return true if the call was cancelled, false if it had already ended.
+     */
+    bool cancel(uint32_t call_id);
+
+    /**
+     * \return The number of calls that are still waiting for a reply.
+     */
+    std::size_t getPendingCallCount() const;
+
+    /**
+     * Set the function that handles incoming requests.
+     *
+     * Requests that arrive while no handler is set are dropped, which makes the call
+     * on the other side time out.
+     *
+     * \param handler The handler, or nullptr to stop handling requests.
+     */
+    void setRequestHandler(RequestHandler handler);
+
+    /**
+     * Reply to a request that was passed to the request handler.
+     *
+     * \param call_id The id of the request, as passed to the request handler.
+     * \param reply The reply to send. Its type must be registered with the socket.
+     *
+     * \return true if the reply was queued to be sent, false if not.
+     */
+    bool reply(uint32_t call_id, MessagePtr reply);
+
+private:
+    // So the socket can hand us tagged messages without making this part of the public interface.
+    friend class Socket;
+
+    // Called by the socket for every tagged message that arrives.
+    void messageReceived(bool is_reply, uint32_t call_id, const MessagePtr& message);
+
+    // Called by the socket when its state changes.
+    void stateChanged(SocketState state);
+
+    // Called by the socket when it is destroyed.
+    void forgetSocket();
+
+    // Copy and assignment is not supported.
+    RpcChannel(const RpcChannel&);
+    RpcChannel& operator=(const RpcChannel& other);
+
+    class Private;
+    const std::unique_ptr<Private> d;
+};
+} // namespace Arcus
+
+#endif // ARCUS_RPC_CHANNEL_H
@@ -4,14 +4,23 @@
 #ifndef ARCUS_SOCKET_H
 #define ARCUS_SOCKET_H
 
+#include <chrono>
+#include <future>
+#include <iosfwd>
 #include <memory>
 
+#include "Arcus/Awaitables.h"
 #include "Arcus/Error.h"
+#include "Arcus/SocketOptions.h"
+#include "Arcus/SocketStatistics.h"
 #include "Arcus/Types.h"
 
 namespace Arcus
 {
+class MessageTypeStore;
+class RpcChannel;
 class SocketListener;
+class SocketSelector;
 
 /**
  * \brief Threaded socket class.
@@ -56,6 +65,17 @@ public:
      */
     virtual bool registerMessageType(const google::protobuf::Message* message_type);
 
+    /**
+     * Register a generated message class to handle.
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     */
+    template<typename T>
+    bool registerMessageType()
+    {
+        return registerMessageType(&T::default_instance());
+    }
+
     /**
      * Register all message types contained in a Protobuf protocol description file.
      *
@@ -65,8 +85,230 @@ public:
      */
     virtual bool registerAllMessageTypes(const std::string& file_name);
 
+    /**
+     * Register all message types of the protocol file a precompiled descriptor set was made for.
+     *
+     * The files it imports are only used to build it, see MessageTypeStore::registerAllMessageTypesFromDescriptorSet().
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     *
+     * \param file_name The path to a descriptor set written by `protoc --include_imports --descriptor_set_out`.
+     */
+    bool registerAllMessageTypesFromDescriptorSet(const std::string& file_name);
+
+    /**
+     * Register all message types contained in a precompiled descriptor set in memory.
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     *
+     * \param data The serialized descriptor set, such as one embedded with arcus_embed_descriptor_set().
+     * \param size The size of data in bytes.
+     */
+    bool registerAllMessageTypesFromDescriptorSet(const char* data, std::size_t size);
+
     virtual void dumpMessageTypes();
 
+    /**
+     * Use a message type store that is shared with other sockets.
+     *
+     * Building the descriptors and prototypes of a protocol once and sharing them saves
+     * memory and setup time when there are many connections. Freeze the store before
+     * sharing it, see MessageTypeStore::freeze(), and do not register further types with
+     * it. The types the socket registered itself are discarded, and registering types
+     * with the socket fails while it uses a shared store.
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     *
+     * \param store The store to use, or nullptr to go back to an empty store of its own.
+     */
+    void setMessageTypeStore(std::shared_ptr<const MessageTypeStore> store);
+
+    /**
+     * Drive the socket from the caller's event loop instead of a worker thread.
+     *
+     * In embedded mode connect() and listen() do not create a thread. Instead, the
+     * caller polls the descriptor returned by getNativeHandle() for the events
+     * returned by getIoInterest() and calls process() when it becomes ready. All
+     * listener callbacks are then made from the thread calling process().
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     *
+     * \param embedded true to run without a worker thread, false to use the default threaded mode.
+     */
+    void setEmbedded(bool embedded);
+
+    /**
+     * \return true if the socket runs in embedded mode, false if it runs its own worker thread.
+     */
+    bool isEmbedded() const;
+
+    /**
+     * Get the platform descriptor of the socket.
+     *
+     * \return The descriptor to poll in embedded mode, or -1 if there currently is none.
+     */
+    int getNativeHandle() const;
+
+    /**
+     * Get the events an embedded socket wants to be woken up for.
+     *
+     * This changes as the socket makes progress, so query it again after each call
+     * to process() or sendMessage(), and after taking messages when the receive queue
+     * has a high-water mark, see SocketOptions::receive_high_water_mark.
+     */
+    IoInterest getIoInterest() const;
+
+    /**
+     * Perform all I/O and message handling that can be done without blocking.
+     *
+     * Only valid in embedded mode. Besides calling this whenever the descriptor is
+     * ready, call it at least every few hundred milliseconds so keep-alives are sent.
+     */
+    void process();
+
+    /**
+     * Spread the messages of this socket over several TCP connections.
+     *
+     * A single TCP connection is limited by its congestion window, which on links
+     * with a high bandwidth-delay product can keep it from using the available
+     * bandwidth. With more than one stream, messages are distributed round-robin
+     * over the streams and put back in order by the receiving side, so the
+     * application still sees a single ordered sequence of messages.
+     *
+     * Both sides must use the same stream count. Striping is not available in
+     * embedded mode or for in-process connections.
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     *
+     * \param count The amount of TCP connections to use, at least 1.
+     */
+    void setStreamCount(unsigned count);
+
+    /**
+     * \return The amount of TCP connections this socket uses.
+     */
+    unsigned getStreamCount() const;
+
+    /**
+     * Keep messages until the other side acknowledges them, so a dropped connection can be resumed.
+     *
+     * With session resume enabled, both sides count the messages they exchange and
+     * periodically acknowledge what they received. When the connection is lost, the
+     * messages that were not acknowledged and everything still in the send queue are
+     * kept. After reset() and connecting again, only the messages the other side did
+     * not receive are sent again, so no work is lost.
+     *
+     * The session ends when either side closes the socket with close(), after which
+     * the next connection starts a new session. Both sides must enable session resume.
+     * It is not available in embedded mode, with multiple streams or for in-process
+     * connections.
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     *
+     * \param enabled true to keep messages for resuming, false to drop them on disconnect.
+     */
+    void setSessionResume(bool enabled);
+
+    /**
+     * \return true if session resume is enabled.
+     */
+    bool isSessionResumeEnabled() const;
+
+    /**
+     * Set the tuning options of the TCP connections.
+     *
+     * The options are applied when the connections are created or accepted, see
+     * SocketOptions for the available profiles.
+     *
+     * If the socket state is not SocketState::Initial, this method will do nothing.
+     *
+     * \param options The options to use.
+     */
+    void setOptions(const SocketOptions& options);
+
+    /**
+     * \return The tuning options of the TCP connections.
+     */
+    SocketOptions getOptions() const;
+
+    /**
+     * Get the smoothed round trip time to the other side.
+     *
+     * This is only measured when SocketOptions::measure_round_trip_time is set and
+     * can be used to adapt batching and pacing to the connection.
+     *
+     * \return The round trip time, or zero if it was not measured on the current connection yet.
+     */
+    std::chrono::microseconds getSmoothedRoundTripTime() const;
+
+    /**
+     * Get a snapshot of the traffic, queues and errors of this socket.
+     *
+     * Keeping the statistics costs a few atomic increments per message, so they are
+     * always kept. Taking a snapshot is cheap enough to do every second.
+     *
+     * \return The statistics since the socket was created.
+     */
+    SocketStatistics getStatistics() const;
+
+    /**
+     * Periodically pass the statistics to the listeners while connected.
+     *
+     * SocketListener::statisticsUpdated() is called from the worker thread, or for an
+     * embedded socket from process(), at most once per interval. The worker checks at
+     * least every 250 ms, so shorter intervals are not kept precisely when idle.
+     *
+     * \param interval How often to report, or 0 to stop reporting.
+     */
+    void setStatisticsInterval(std::chrono::milliseconds interval);
+
+    /**
+     * Trace the stages every message passes through, to find out where time goes.
+     *
+     * For messages sent, this records when they were queued, and when writing them
+     * started and ended. For messages received, this records when their frame was
+     * complete, when parsing was done and when the application took them. Events go
+     * into a ring buffer that keeps the most recent ones, see writeTrace().
+     *
+     * Embedded sockets write frames together from a buffer, so for those only the start
+     * of writing is recorded. Without tracing, the only cost is a pointer check.
+     *
+     * This can only be called before connect() or listen(), or after reset(). Otherwise,
+     * this method will do nothing.
+     *
+     * \param capacity The amount of events to keep, or 0 to stop tracing.
+     */
+    void setTracing(std::size_t capacity);
+
+    /**
+     * Write the traced events in the Chrome trace event format.
+     *
+     * The result can be opened with chrome://tracing or https://ui.perfetto.dev, where
+     * each message shows up as slices for the time it was queued, written, parsed and
+     * waiting to be taken. Messages are identified by their address.
+     *
+     * \param stream The stream to write the JSON to.
+     *
+     * \return false if tracing is not enabled.
+     */
+    bool writeTrace(std::ostream& stream) const;
+
+    /**
+     * Record the frames this socket sends and receives to a file.
+     *
+     * Every frame is stored with its type ID, payload and the time it passed, so real
+     * traffic can be fed through sockets again with the arcus_replay tool. The file is
+     * flushed when the socket closes or goes to the error state.
+     *
+     * This can only be called before connect() or listen(), or after reset(). Otherwise,
+     * this method will do nothing.
+     *
+     * \param file_name The file to write, which is overwritten, or an empty string to stop capturing.
+     *
+     * \return false if the file could not be created.
+     */
+    bool setCapture(const std::string& file_name);
+
     /**
      * Add a listener object that will be notified of socket events.
      *
@@ -101,11 +343,44 @@ public:
      */
     virtual void listen(const std::string& address, uint16_t port);
 
+    /**
+     * Connect to another socket in the same process.
+     *
+     * Messages are passed between the two sockets through memory, without serializing
+     * or parsing them. Both sockets go through the same states and notify their
+     * listeners just like with a network connection. Both sockets must be in
+     * SocketState::Initial and must not be in embedded mode.
+     *
+     * \param peer The socket to connect to.
+     * \param copy_messages If true, the receiving socket gets a deep copy of each message
+     *                      instead of the instance that was sent.
+     */
+    void connectInProcess(Socket* peer, bool copy_messages = false);
+
     /**
      * Close the connection and stop handling any messages.
+     *
+     * This blocks until the socket is closed, which takes at most
+     * SocketOptions::close_timeout milliseconds.
      */
     virtual void close();
 
+    /**
+     * Start closing the connection without waiting for it to complete.
+     *
+     * Messages that are still queued are sent and the close handshake is performed
+     * on the worker thread. Anything that was not sent when the deadline expires is
+     * dropped, and the handshake is abandoned at that point as well.
+     *
+     * The worker thread is joined by close(), reset() or the destructor.
+     *
+     * \param flush_timeout How long sending the queued messages and the handshake may take.
+     *
+     * \return A future that becomes ready once the socket is closed. Its value is true
+     *         if everything queued was sent and the other side confirmed the close.
+     */
+    std::future<bool> closeAsync(std::chrono::milliseconds flush_timeout);
+
     /**
      * Reset a socket for re-use. State must be Closed or Error
      */
@@ -116,11 +391,66 @@ public:
      */
     virtual bool sendMessage(MessagePtr message);
 
+    /**
+     * Send a message across the socket and track when it leaves.
+     *
+     * This allows releasing resources tied to a message as soon as it is written, and
+     * measuring how long messages take to reach the other side.
+     *
+     * \param message The message to send.
+     * \param completion Whether the future becomes ready once the message is written or
+     *                   once the other side acknowledged it.
+     *
+     * \return A future for the receipt of the message. If the socket closes before the
+     *         requested completion, it becomes ready with the parts that did not happen unset.
+     */
+    std::future<SendReceipt> sendMessage(MessagePtr message, SendCompletion completion);
+
     /**
      * Remove and return the next pending message from the queue with condition blocking.
      */
     virtual MessagePtr takeNextMessage();
 
+    /**
+     * Remove and return the next pending message from the queue without blocking.
+     *
+     * \return The next message or an invalid pointer if no message is pending.
+     */
+    MessagePtr tryTakeNextMessage();
+
+    /**
+     * Wait for the next message in a coroutine, using `co_await socket.receive()`.
+     *
+     * The coroutine is suspended until a message arrives, instead of blocking the
+     * thread like takeNextMessage() does.
+     *
+     * \return An awaitable that results in the message, or an invalid pointer once the socket closed.
+     */
+    ReceiveAwaitable receive();
+
+    /**
+     * Wait for the next message in a coroutine, using `co_await socket.receive<T>()`.
+     *
+     * \return An awaitable that results in the message cast to T, or an invalid pointer
+     *         if it is of a different type or the socket closed.
+     */
+    template<typename T>
+    TypedReceiveAwaitable<T> receive()
+    {
+        return TypedReceiveAwaitable<T>(*this);
+    }
+
+    /**
+     * Send a message in a coroutine, using `co_await socket.send(message)`.
+     *
+     * The coroutine is suspended until the message was written.
+     *
+     * \param message The message to send.
+     *
+     * \return An awaitable that results in the receipt of the message.
+     */
+    SendAwaitable send(MessagePtr message);
+
     /**
      * Create an instance of a Message class.
      *
@@ -129,6 +459,37 @@ public:
     virtual MessagePtr createMessage(const std::string& type_name);
 
 private:
+    // So a selector can observe this socket without making that part of the public interface.
+    friend class SocketSelector;
+
+    // Register or unregister a selector that should be woken up on events.
+    void addSelector(SocketSelector* selector);
+    void removeSelector(SocketSelector* selector);
+    // A number that changes whenever a state change, error or message is reported.
+    uint32_t getEventSerial() const;
+    // Are there messages waiting in the receive queue?
+    bool hasPendingMessages() const;
+
+    // So coroutines can wait for messages without making that part of the public interface.
+    friend class ReceiveAwaitable;
+    friend class SendAwaitable;
+
+    // Take the next message, or register the coroutine to resume with it.
+    // Returns false if the coroutine should not be suspended.
+    bool takeOrWaitForMessage(ReceiveAwaitable* waiter);
+    // Queue a message and register the coroutine to resume once it was written.
+    // Returns false if the coroutine should not be suspended.
+    bool sendAndWait(SendAwaitable* waiter);
+
+    // So an RPC channel can send and receive tagged messages without making that part of the public interface.
+    friend class RpcChannel;
+
+    // Attach or detach the channel tagged messages are handed to. Only one channel can be attached.
+    bool attachRpcChannel(RpcChannel* channel);
+    void detachRpcChannel(RpcChannel* channel);
+    // Queue a message tagged as a request or a reply to the call with the given id.
+    bool sendTaggedMessage(MessagePtr message, bool is_reply, uint32_t call_id);
+
     // Copy and assignment is not supported.
     Socket(const Socket&);
     Socket& operator=(const Socket& other);
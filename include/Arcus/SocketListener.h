@@ -10,6 +10,7 @@ namespace Arcus
 {
 class Socket;
 class Error;
+struct SocketStatistics;
 
 /**
  * Interface for socket event listeners.
@@ -59,6 +60,14 @@ public:
      * \param errorMessage The error message.
      */
     virtual void error(const Error& error) = 0;
+    /**
+     * Called periodically with the statistics of the socket, see Socket::setStatisticsInterval().
+     *
+     * Does nothing by default.
+     *
+     * \param statistics A snapshot of the statistics.
+     */
+    virtual void statisticsUpdated(const SocketStatistics& statistics);
 
 private:
     // So we can call setSocket from Socket without making it public interface.
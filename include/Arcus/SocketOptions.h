@@ -0,0 +1,131 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_SOCKET_OPTIONS_H
+#define ARCUS_SOCKET_OPTIONS_H
+
+#include <cstddef>
+#include <string>
+
+namespace Arcus
+{
+/**
+ * \brief Tuning of the TCP connections used by a Socket.
+ *
+ * The options are applied to the platform sockets when they are created and
+ * when an incoming connection is accepted. A value of 0 for any of the sizes
+ * or durations means the system default is kept or the feature is disabled.
+ *
+ * Rather than setting each field, start from one of the named profiles and
+ * adjust from there.
+ */
+struct SocketOptions
+{
+    /**
+     * The default profile. Nagle's algorithm is disabled since frames are already
+     * written in batches, everything else is left to the system.
+     */
+    static SocketOptions defaults();
+
+    /**
+     * A profile for small, interactive messages where every millisecond counts.
+     *
+     * Disables Nagle's algorithm, busy-polls for incoming data and keeps the buffers
+     * small so messages do not queue up behind each other.
+     */
+    static SocketOptions lowLatency();
+
+    /**
+     * A profile for moving large amounts of data, such as sliced models.
+     *
+     * Uses large buffers that grow with the observed message sizes and corks batches
+     * of frames so they leave in full segments.
+     */
+    static SocketOptions bulkThroughput();
+
+    /// Disable Nagle's algorithm so small frames are sent immediately.
+    bool no_delay = true;
+
+    /// Size of the kernel send buffer in bytes.
+    int send_buffer_size = 0;
+
+    /// Size of the kernel receive buffer in bytes.
+    int receive_buffer_size = 0;
+
+    /// How long blocking reads busy-poll for data before sleeping, in microseconds. Only supported on Linux.
+    int busy_poll = 0;
+
+    /// Hold back partial segments while a batch of frames is written. Only supported on Linux.
+    bool cork = false;
+
+    /// Grow the buffers when the messages sent or received are larger than they can hold.
+    bool adaptive_buffers = false;
+
+    /// The largest size in bytes the buffers are grown to when adaptive_buffers is set.
+    int max_buffer_size = 4 * 1024 * 1024;
+
+    /**
+     * Submit batches of frames through io_uring when libArcus was built with ENABLE_IO_URING.
+     * Only the writes go through the ring, the buffers are not registered with it and reads
+     * still use recv(). When the kernel does not support io_uring, regular sends are used.
+     */
+    bool use_io_uring = false;
+
+    /// Milliseconds without sending anything after which an idle connection is probed.
+    int keep_alive_interval = 500;
+
+    /**
+     * Milliseconds without receiving anything after which the other side is considered
+     * gone and the socket goes to the error state. Since both sides probe idle connections,
+     * this should be several times keep_alive_interval.
+     */
+    int dead_peer_timeout = 0;
+
+    /// Probe with pings that the other side answers, to measure the round trip time. Both sides need libArcus with support for this.
+    bool measure_round_trip_time = false;
+
+    /**
+     * Read the connection on a thread of its own while the worker thread writes, so large
+     * writes and incoming messages do not hold each other up. Listeners are then also called
+     * from the reader thread. Only used in threaded mode, and not together with session resume.
+     */
+    bool duplex_threads = false;
+
+    /// Milliseconds Socket::close() may take to send what is queued and complete the close handshake.
+    int close_timeout = 10000;
+
+    /**
+     * Keep messages that arrive while others are still waiting to be taken in their serialized
+     * form, and parse them when they are taken. A backlog then takes about its size on the wire
+     * instead of the often several times larger size of the parsed messages, and the parsing
+     * moves from the worker thread to the thread taking the messages. Messages received over
+     * several streams or through an RpcChannel are always parsed right away.
+     */
+    bool defer_parsing = false;
+
+    /**
+     * Bytes of serialized messages in the receive queue above which further ones that are kept
+     * serialized are written to a temporary file until they are taken, or 0 to keep them all in
+     * memory. Only used together with defer_parsing.
+     */
+    std::size_t receive_memory_limit = 0;
+
+    /// The directory for that temporary file, or empty to use the temporary directory of the system.
+    std::string spill_directory;
+
+    /**
+     * Bytes of serialized messages in the receive queue at which the socket stops reading the
+     * connection, or 0 to always read. The kernel buffers then fill up and TCP flow control slows
+     * the other side down, without any change to the protocol. Reading resumes once the application
+     * took enough messages to drain the queue to receive_low_water_mark. The frame that crosses the
+     * mark is still queued, so the queue can go over it by one frame. Embedded sockets stop asking
+     * for read events meanwhile, see Socket::getIoInterest(). Not used for in-process connections.
+     */
+    std::size_t receive_high_water_mark = 0;
+
+    /// Bytes in the receive queue at which reading resumes, or 0 for half of receive_high_water_mark.
+    std::size_t receive_low_water_mark = 0;
+};
+} // namespace Arcus
+
+#endif // ARCUS_SOCKET_OPTIONS_H
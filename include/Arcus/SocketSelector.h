@@ -0,0 +1,94 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_SOCKET_SELECTOR_H
+#define ARCUS_SOCKET_SELECTOR_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "Arcus/Types.h"
+
+namespace Arcus
+{
+class Socket;
+
+/**
+ * \brief Wait on several sockets from a single thread.
+ *
+ * A selector allows one consumer thread to service any number of sockets
+ * without dedicating a blocked thread to each of them. Register the sockets
+ * with addSocket() and call wait() to block until at least one of them has
+ * pending messages, changed state or reported an error since the last call.
+ *
+ * A socket stays ready for as long as it has messages in its receive queue,
+ * so use Socket::tryTakeNextMessage() to drain it without blocking.
+ */
+class SocketSelector
+{
+public:
+    SocketSelector();
+    ~SocketSelector();
+
+    /**
+     * Add a socket to the set of sockets to wait on.
+     *
+     * \param socket The socket to add. It must outlive its registration or remove itself on destruction.
+     *
+     * \return true if the socket was added, false if it was invalid or already added.
+     */
+    bool addSocket(Socket* socket);
+
+    /**
+     * Remove a socket from the set of sockets to wait on.
+     *
+     * \param socket The socket to remove.
+     *
+     * \return true if the socket was removed, false if it was not part of this selector.
+     */
+    bool removeSocket(Socket* socket);
+
+    /**
+     * Block until at least one of the sockets is ready or interrupt() is called.
+     *
+     * \return The sockets that are ready. This can be empty if the wait was interrupted.
+     */
+    std::vector<Socket*> wait();
+
+    /**
+     * Block until at least one of the sockets is ready, interrupt() is called or the timeout expires.
+     *
+     * \param timeout The maximum amount of time to wait.
+     *
+     * \return The sockets that are ready. This is empty if the timeout expired or the wait was interrupted.
+     */
+    std::vector<Socket*> waitFor(std::chrono::milliseconds timeout);
+
+    /**
+     * Wake up a thread that is blocked in wait() or waitFor().
+     *
+     * This can be called from any thread, for example to make the consumer thread exit.
+     */
+    void interrupt();
+
+private:
+    // So the sockets can notify us of events without making this part of the public interface.
+    friend class Socket;
+
+    // Called by a registered socket whenever something happens on it.
+    void wakeUp();
+
+    // Called by a registered socket when it is destroyed.
+    void forgetSocket(Socket* socket);
+
+    // Copy and assignment is not supported.
+    SocketSelector(const SocketSelector&);
+    SocketSelector& operator=(const SocketSelector& other);
+
+    class Private;
+    const std::unique_ptr<Private> d;
+};
+} // namespace Arcus
+
+#endif // ARCUS_SOCKET_SELECTOR_H
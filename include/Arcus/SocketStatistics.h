@@ -0,0 +1,107 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_SOCKET_STATISTICS_H
+#define ARCUS_SOCKET_STATISTICS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace Arcus
+{
+/**
+ * \brief A distribution of durations, counted in buckets that double in width.
+ *
+ * Bucket 0 counts durations below 1 microsecond, bucket i counts durations of at
+ * least 2^(i-1) and less than 2^i microseconds, and the last bucket also counts
+ * everything longer.
+ */
+struct DurationHistogram
+{
+    static constexpr std::size_t BUCKET_COUNT = 32;
+
+    std::array<uint64_t, BUCKET_COUNT> buckets = {};
+    uint64_t count = 0; ///< The amount of durations recorded.
+    std::chrono::microseconds total = std::chrono::microseconds(0); ///< The sum of all durations recorded.
+    std::chrono::microseconds maximum = std::chrono::microseconds(0); ///< The longest duration recorded.
+
+    /**
+     * \return The average duration, or 0 if nothing was recorded.
+     */
+    std::chrono::microseconds mean() const;
+
+    /**
+     * Estimate a percentile of the recorded durations.
+     *
+     * \param percentile The percentile to estimate, from 0 to 100.
+     *
+     * \return The upper bound of the bucket the percentile falls in, but no more than
+     *         the maximum. 0 if nothing was recorded.
+     */
+    std::chrono::microseconds percentile(double percentile) const;
+};
+
+/**
+ * The traffic of a single message type.
+ */
+struct MessageTypeStatistics
+{
+    uint64_t messages_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t messages_received = 0;
+    uint64_t bytes_received = 0;
+};
+
+/**
+ * \brief A snapshot of what a Socket has been doing, see Socket::getStatistics().
+ *
+ * The counters are kept for the lifetime of the socket, also across reset(). Bytes
+ * are counted as the serialized size of the messages, without framing. Messages
+ * exchanged with a socket in the same process are not serialized, so for those only
+ * the messages are counted.
+ *
+ * The counters are updated independently of each other, so a snapshot taken while
+ * the socket is busy can be off by the messages in flight at that moment.
+ */
+struct SocketStatistics
+{
+    std::chrono::steady_clock::time_point time; ///< When the snapshot was taken.
+
+    uint64_t messages_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t messages_received = 0;
+    uint64_t bytes_received = 0;
+
+    /// The traffic per type ID. Types beyond the first 256 seen are counted together under type ID 0.
+    std::map<uint32_t, MessageTypeStatistics> message_types;
+
+    std::size_t send_queue_depth = 0; ///< The amount of messages waiting to be sent.
+    std::size_t send_queue_peak = 0; ///< The largest send_queue_depth seen.
+    std::size_t receive_queue_depth = 0; ///< The amount of received messages waiting to be taken.
+    std::size_t receive_queue_peak = 0; ///< The largest receive_queue_depth seen.
+    std::size_t send_queue_bytes = 0; ///< The serialized size of the messages waiting to be sent.
+    std::size_t send_queue_bytes_peak = 0; ///< The largest send_queue_bytes seen.
+    std::size_t receive_queue_bytes = 0; ///< The serialized size of the received messages waiting to be taken, spilled ones included.
+    std::size_t receive_queue_bytes_peak = 0; ///< The largest receive_queue_bytes seen.
+    std::size_t receive_queue_spilled_bytes = 0; ///< The part of receive_queue_bytes written to a temporary file, see SocketOptions::receive_memory_limit.
+
+    uint64_t messages_deferred = 0; ///< Received messages kept serialized until taken, see SocketOptions::defer_parsing.
+    uint64_t messages_spilled = 0; ///< The part of messages_deferred that was written to a temporary file.
+    uint64_t receive_pauses = 0; ///< Times reading stopped because the receive queue reached SocketOptions::receive_high_water_mark.
+
+    DurationHistogram parse_time; ///< Time spent parsing received messages.
+    DurationHistogram send_queue_time; ///< Time from queueing a message until it is taken to be sent.
+    DurationHistogram receive_queue_time; ///< Time from receiving a message until the application takes it.
+
+    uint64_t keep_alives_sent = 0; ///< Probes of idle connections, including pings.
+    uint64_t keep_alives_received = 0;
+
+    uint64_t errors = 0; ///< Errors reported to listeners, not counting debug messages.
+    uint64_t fatal_errors = 0; ///< Errors that put the socket in the error state.
+};
+} // namespace Arcus
+
+#endif // ARCUS_SOCKET_STATISTICS_H
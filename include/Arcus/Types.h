@@ -4,6 +4,7 @@
 #ifndef ARCUS_TYPES_H
 #define ARCUS_TYPES_H
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -36,6 +37,38 @@ enum class SocketState
     Closed, ///< Closed, not running.
     Error ///< A fatal error happened that blocks the socket from operating.
 };
+
+/**
+ * The I/O events an embedded socket wants to be woken up for.
+ */
+enum class IoInterest
+{
+    None, ///< Nothing to wait for, the descriptor should not be polled.
+    Read, ///< Wait until the descriptor is readable.
+    Write, ///< Wait until the descriptor is writable.
+    ReadWrite ///< Wait until the descriptor is readable or writable.
+};
+
+/**
+ * When the future of a tracked message becomes ready, see Socket::sendMessage(MessagePtr, SendCompletion).
+ */
+enum class SendCompletion
+{
+    Written, ///< Once the message was handed to the kernel in full.
+    Acknowledged ///< Once the other side confirmed receiving it. Requires session resume, otherwise this is the same as Written.
+};
+
+/**
+ * What happened to a tracked message.
+ */
+struct SendReceipt
+{
+    bool written = false; ///< The message was handed to the kernel, or to the peer for in-process connections.
+    bool acknowledged = false; ///< The other side confirmed receiving the message.
+    std::chrono::steady_clock::time_point queued_time; ///< When the message was queued.
+    std::chrono::steady_clock::time_point written_time; ///< When the message was written, if it was.
+    std::chrono::steady_clock::time_point acknowledged_time; ///< When the acknowledgement arrived, if it did.
+};
 } // namespace Arcus
 
 #endif // ARCUS_TYPES_H
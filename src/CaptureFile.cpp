@@ -0,0 +1,116 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "CaptureFile_p.h"
+
+#include <array>
+#include <cstring>
+
+using namespace Arcus::Private;
+
+namespace
+{
+constexpr char CAPTURE_MAGIC[8] = { 'A', 'R', 'C', 'U', 'S', 'C', 'A', 'P' };
+constexpr uint32_t CAPTURE_VERSION = 1;
+// Time, header, type ID, size and direction.
+constexpr std::size_t FRAME_PREFIX_SIZE = 8 + 4 + 4 + 4 + 1;
+
+void putLittleEndian(char* destination, uint64_t value, std::size_t bytes)
+{
+    for (std::size_t i = 0; i < bytes; ++i)
+    {
+        destination[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+uint64_t getLittleEndian(const char* source, std::size_t bytes)
+{
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < bytes; ++i)
+    {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(source[i])) << (8 * i);
+    }
+    return value;
+}
+} // namespace
+
+bool CaptureWriter::open(const std::string& file_name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    file.open(file_name, std::ios::binary | std::ios::trunc);
+    if (! file)
+    {
+        return false;
+    }
+
+    char header[12];
+    std::memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    putLittleEndian(header + 8, CAPTURE_VERSION, 4);
+    file.write(header, sizeof(header));
+    start = std::chrono::steady_clock::now();
+    return static_cast<bool>(file);
+}
+
+void CaptureWriter::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file.is_open())
+    {
+        file.close();
+    }
+}
+
+void CaptureWriter::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    file.flush();
+}
+
+void CaptureWriter::write(CapturedFrame::Direction direction, uint32_t header, uint32_t type_id, const char* payload, std::size_t size)
+{
+    const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    std::array<char, FRAME_PREFIX_SIZE> prefix;
+    putLittleEndian(prefix.data(), static_cast<uint64_t>(time.count()), 8);
+    putLittleEndian(prefix.data() + 8, header, 4);
+    putLittleEndian(prefix.data() + 12, type_id, 4);
+    putLittleEndian(prefix.data() + 16, size, 4);
+    prefix[20] = static_cast<char>(direction);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (! file.is_open())
+    {
+        return;
+    }
+    file.write(prefix.data(), prefix.size());
+    file.write(payload, static_cast<std::streamsize>(size));
+}
+
+bool CaptureReader::open(const std::string& file_name)
+{
+    file.open(file_name, std::ios::binary);
+    char header[12];
+    if (! file.read(header, sizeof(header)))
+    {
+        return false;
+    }
+    return std::memcmp(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) == 0 && getLittleEndian(header + 8, 4) == CAPTURE_VERSION;
+}
+
+bool CaptureReader::next(CapturedFrame& frame)
+{
+    std::array<char, FRAME_PREFIX_SIZE> prefix;
+    if (! file.read(prefix.data(), prefix.size()))
+    {
+        return false;
+    }
+
+    frame.time = std::chrono::nanoseconds(static_cast<int64_t>(getLittleEndian(prefix.data(), 8)));
+    frame.header = static_cast<uint32_t>(getLittleEndian(prefix.data() + 8, 4));
+    frame.type_id = static_cast<uint32_t>(getLittleEndian(prefix.data() + 12, 4));
+    const std::size_t size = static_cast<std::size_t>(getLittleEndian(prefix.data() + 16, 4));
+    frame.direction = static_cast<CapturedFrame::Direction>(prefix[20]);
+
+    frame.payload.resize(size);
+    return size == 0 || static_cast<bool>(file.read(&frame.payload[0], static_cast<std::streamsize>(size)));
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_CAPTURE_FILE_P_H
+#define ARCUS_CAPTURE_FILE_P_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace Arcus
+{
+namespace Private
+{
+/**
+ * A frame as stored in a capture file, see Socket::setCapture().
+ *
+ * A capture file starts with the 8 bytes "ARCUSCAP" and a 32-bit format version,
+ * followed by the frames. Each frame is stored as its time in nanoseconds since the
+ * capture started (64-bit), the frame header, the type ID and the payload size
+ * (32-bit each), a byte telling the direction and finally the payload. All numbers
+ * are little-endian.
+ */
+struct CapturedFrame
+{
+    enum class Direction : uint8_t
+    {
+        Received = 0,
+        Sent = 1
+    };
+
+    std::chrono::nanoseconds time;
+    uint32_t header;
+    uint32_t type_id;
+    Direction direction;
+    std::string payload;
+};
+
+/**
+ * Appends frames to a capture file. Safe to use from several threads.
+ */
+class CaptureWriter
+{
+public:
+    /**
+     * Create the file and write its header.
+     *
+     * \return false if the file could not be written.
+     */
+    bool open(const std::string& file_name);
+    void close();
+    void flush();
+
+    void write(CapturedFrame::Direction direction, uint32_t header, uint32_t type_id, const char* payload, std::size_t size);
+
+private:
+    std::mutex mutex;
+    std::ofstream file;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * Reads the frames of a capture file in order.
+ */
+class CaptureReader
+{
+public:
+    /**
+     * Open a capture file and check its header.
+     *
+     * \return false if the file could not be read or is not a capture file.
+     */
+    bool open(const std::string& file_name);
+
+    /**
+     * Read the next frame.
+     *
+     * \return false at the end of the file, or if the file is truncated.
+     */
+    bool next(CapturedFrame& frame);
+
+private:
+    std::ifstream file;
+};
+} // namespace Private
+} // namespace Arcus
+
+#endif // ARCUS_CAPTURE_FILE_P_H
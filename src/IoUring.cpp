@@ -0,0 +1,352 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "IoUring_p.h"
+
+#if defined(ARCUS_IO_URING) && defined(__linux__)
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace Arcus::Private;
+
+Arcus::Private::IoUring::IoUring()
+    : _ring_fd(-1)
+    , _entries(0)
+    , _submission_ring(nullptr)
+    , _submission_ring_size(0)
+    , _completion_ring(nullptr)
+    , _completion_ring_size(0)
+    , _submission_entries(nullptr)
+    , _submission_entries_size(0)
+    , _submission_tail(nullptr)
+    , _submission_mask(nullptr)
+    , _submission_array(nullptr)
+    , _completion_head(nullptr)
+    , _completion_tail(nullptr)
+    , _completion_mask(nullptr)
+    , _completion_entries(nullptr)
+{
+}
+
+#if defined(ARCUS_IO_URING) && defined(__linux__)
+
+Arcus::Private::IoUring::~IoUring()
+{
+    if (_submission_entries)
+    {
+        ::munmap(_submission_entries, _submission_entries_size);
+    }
+    if (_completion_ring && _completion_ring != _submission_ring)
+    {
+        ::munmap(_completion_ring, _completion_ring_size);
+    }
+    if (_submission_ring)
+    {
+        ::munmap(_submission_ring, _submission_ring_size);
+    }
+    if (_ring_fd != -1)
+    {
+        ::close(_ring_fd);
+    }
+}
+
+bool Arcus::Private::IoUring::initialize(unsigned entries)
+{
+    io_uring_params parameters;
+    std::memset(&parameters, 0, sizeof(parameters));
+
+    // Fails with ENOSYS on old kernels and EPERM when io_uring is disabled, in which case the caller falls back.
+    int ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &parameters));
+    if (ring_fd < 0)
+    {
+        return false;
+    }
+    _ring_fd = ring_fd;
+    _entries = parameters.sq_entries;
+
+    // Waiting with a timeout is what lets sends give up on a peer that stopped reading.
+    if ((parameters.features & IORING_FEAT_EXT_ARG) == 0)
+    {
+        return false;
+    }
+
+    _submission_ring_size = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+    _completion_ring_size = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+    {
+        _submission_ring_size = std::max(_submission_ring_size, _completion_ring_size);
+        _completion_ring_size = _submission_ring_size;
+    }
+
+    _submission_ring = ::mmap(nullptr, _submission_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+    if (_submission_ring == MAP_FAILED)
+    {
+        _submission_ring = nullptr;
+        return false;
+    }
+
+    if (single_mmap)
+    {
+        _completion_ring = _submission_ring;
+    }
+    else
+    {
+        _completion_ring = ::mmap(nullptr, _completion_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+        if (_completion_ring == MAP_FAILED)
+        {
+            _completion_ring = nullptr;
+            return false;
+        }
+    }
+
+    _submission_entries_size = parameters.sq_entries * sizeof(io_uring_sqe);
+    _submission_entries = ::mmap(nullptr, _submission_entries_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+    if (_submission_entries == MAP_FAILED)
+    {
+        _submission_entries = nullptr;
+        return false;
+    }
+
+    char* submission_ring = static_cast<char*>(_submission_ring);
+    _submission_tail = reinterpret_cast<unsigned*>(submission_ring + parameters.sq_off.tail);
+    _submission_mask = reinterpret_cast<unsigned*>(submission_ring + parameters.sq_off.ring_mask);
+    _submission_array = reinterpret_cast<unsigned*>(submission_ring + parameters.sq_off.array);
+
+    char* completion_ring = static_cast<char*>(_completion_ring);
+    _completion_head = reinterpret_cast<unsigned*>(completion_ring + parameters.cq_off.head);
+    _completion_tail = reinterpret_cast<unsigned*>(completion_ring + parameters.cq_off.tail);
+    _completion_mask = reinterpret_cast<unsigned*>(completion_ring + parameters.cq_off.ring_mask);
+    _completion_entries = completion_ring + parameters.cq_off.cqes;
+
+    return true;
+}
+
+bool Arcus::Private::IoUring::isValid() const
+{
+    return _submission_entries != nullptr;
+}
+
+std::ptrdiff_t Arcus::Private::IoUring::send(int socket_id, const iovec* vectors, std::size_t count, const std::function<bool()>& keep_waiting)
+{
+    if (! isValid() || count == 0)
+    {
+        return -1;
+    }
+
+    // Each submission can carry IOV_MAX buffers. Anything that does not fit in half of the ring is left
+    // for the next call, the other half is kept free to cancel the submissions.
+    const std::size_t max_vectors = IOV_MAX;
+    const std::size_t submissions = std::min<std::size_t>((count + max_vectors - 1) / max_vectors, std::max(_entries / 2, 1u));
+
+    std::vector<msghdr> headers(submissions);
+    std::vector<std::size_t> expected(submissions, 0);
+    io_uring_sqe* entries = static_cast<io_uring_sqe*>(_submission_entries);
+
+    const unsigned first_tail = __atomic_load_n(_submission_tail, __ATOMIC_RELAXED);
+    unsigned tail = first_tail;
+    for (std::size_t i = 0; i < submissions; ++i)
+    {
+        const std::size_t first = i * max_vectors;
+        const std::size_t length = std::min(max_vectors, count - first);
+
+        std::memset(&headers[i], 0, sizeof(msghdr));
+        headers[i].msg_iov = const_cast<iovec*>(vectors + first);
+        headers[i].msg_iovlen = length;
+        for (std::size_t j = first; j < first + length; ++j)
+        {
+            expected[i] += vectors[j].iov_len;
+        }
+
+        const unsigned index = tail & *_submission_mask;
+        io_uring_sqe* entry = &entries[index];
+        std::memset(entry, 0, sizeof(io_uring_sqe));
+        entry->opcode = IORING_OP_SENDMSG;
+        entry->fd = socket_id;
+        entry->addr = reinterpret_cast<uint64_t>(&headers[i]);
+        entry->len = 1;
+        entry->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        entry->user_data = i;
+        if (i + 1 < submissions)
+        {
+            // Linked submissions execute in order, which keeps the stream intact.
+            entry->flags |= IOSQE_IO_LINK;
+        }
+        _submission_array[index] = index;
+        ++tail;
+    }
+    __atomic_store_n(_submission_tail, tail, __ATOMIC_RELEASE);
+
+    // Submit everything and wait for the completions, usually in a single system call.
+    // The kernel uses the headers until all sends completed, so we cannot return before that.
+    std::vector<int> results(submissions, 0);
+    std::size_t completed = 0;
+    std::size_t submitted = 0;
+    bool cancelled = false;
+    io_uring_cqe* completions = static_cast<io_uring_cqe*>(_completion_entries);
+    while (submitted == 0 || completed < submitted)
+    {
+        unsigned head = __atomic_load_n(_completion_head, __ATOMIC_RELAXED);
+        if (head == __atomic_load_n(_completion_tail, __ATOMIC_ACQUIRE))
+        {
+            __kernel_timespec timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_nsec = 250 * 1000 * 1000;
+            io_uring_getevents_arg argument;
+            std::memset(&argument, 0, sizeof(argument));
+            argument.ts = reinterpret_cast<uint64_t>(&timeout);
+
+            const unsigned to_submit = submitted == 0 ? static_cast<unsigned>(submissions) : 0u;
+            long result = ::syscall(__NR_io_uring_enter, _ring_fd, to_submit, 1u, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument, sizeof(argument));
+            if (to_submit > 0)
+            {
+                if (result < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (result <= 0)
+                {
+                    // Nothing was submitted. The entries point at the headers, which are gone once we
+                    // return, so take them back before a later call submits them.
+                    __atomic_store_n(_submission_tail, first_tail, __ATOMIC_RELEASE);
+                    if (result == 0)
+                    {
+                        errno = EAGAIN;
+                    }
+                    return -1;
+                }
+
+                submitted = static_cast<std::size_t>(result);
+                if (submitted < submissions)
+                {
+                    // Submitted later, the rest would be a chain of its own that is not ordered after this one.
+                    // Take it back as well and leave its buffers to the next call, like after a short send.
+                    __atomic_store_n(_submission_tail, first_tail + static_cast<unsigned>(submitted), __ATOMIC_RELEASE);
+                }
+                continue;
+            }
+
+            // Woken up without completions, either by the timeout or a signal.
+            if (result < 0 && ! cancelled && ((errno != ETIME && errno != EINTR) || ! keep_waiting()))
+            {
+                cancelSends(submitted);
+                cancelled = true;
+            }
+            continue;
+        }
+
+        const io_uring_cqe& completion = completions[head & *_completion_mask];
+        if (completion.user_data < submissions)
+        {
+            results[completion.user_data] = completion.res;
+            ++completed;
+        }
+        // Anything else is the result of a cancellation, which does not matter.
+        __atomic_store_n(_completion_head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    std::ptrdiff_t sent = 0;
+    for (std::size_t i = 0; i < submissions; ++i)
+    {
+        if (results[i] < 0)
+        {
+            if (sent == 0 || cancelled)
+            {
+                errno = cancelled ? ETIMEDOUT : -results[i];
+                return -1;
+            }
+            break;
+        }
+
+        sent += results[i];
+        if (static_cast<std::size_t>(results[i]) < expected[i])
+        {
+            if (cancelled)
+            {
+                // The caller gave up, so the remainder is not going to be sent either.
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            // A short send breaks the chain, the remainder is up to the caller.
+            break;
+        }
+    }
+
+    return sent;
+}
+
+void Arcus::Private::IoUring::cancelSends(std::size_t count)
+{
+    io_uring_sqe* entries = static_cast<io_uring_sqe*>(_submission_entries);
+    unsigned tail = __atomic_load_n(_submission_tail, __ATOMIC_RELAXED);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const unsigned index = tail & *_submission_mask;
+        io_uring_sqe* entry = &entries[index];
+        std::memset(entry, 0, sizeof(io_uring_sqe));
+        entry->opcode = IORING_OP_ASYNC_CANCEL;
+        entry->fd = -1;
+        entry->addr = i;
+        // Marked so its completion is not mistaken for the one of a send.
+        entry->user_data = (uint64_t(1) << 32) | i;
+        _submission_array[index] = index;
+        ++tail;
+    }
+    __atomic_store_n(_submission_tail, tail, __ATOMIC_RELEASE);
+
+    // Sends that already completed are not found, which is fine.
+    unsigned remaining = static_cast<unsigned>(count);
+    while (remaining > 0)
+    {
+        const long result = ::syscall(__NR_io_uring_enter, _ring_fd, remaining, 0u, 0u, nullptr, 0);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            // Take back what the kernel did not take, so the next call does not cancel its own sends.
+            __atomic_store_n(_submission_tail, tail - remaining, __ATOMIC_RELEASE);
+            break;
+        }
+        remaining -= static_cast<unsigned>(result);
+    }
+}
+
+#else
+
+Arcus::Private::IoUring::~IoUring()
+{
+}
+
+bool Arcus::Private::IoUring::initialize(unsigned)
+{
+    return false;
+}
+
+bool Arcus::Private::IoUring::isValid() const
+{
+    return false;
+}
+
+std::ptrdiff_t Arcus::Private::IoUring::send(int, const iovec*, std::size_t, const std::function<bool()>&)
+{
+    return -1;
+}
+
+void Arcus::Private::IoUring::cancelSends(std::size_t)
+{
+}
+
+#endif
@@ -0,0 +1,95 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_IO_URING_P_H
+#define ARCUS_IO_URING_P_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+struct iovec;
+
+namespace Arcus
+{
+namespace Private
+{
+/**
+ * Private class that wraps a minimal io_uring instance for socket writes.
+ *
+ * This talks to the kernel directly instead of through liburing so no extra
+ * dependency is needed. It is only functional on Linux when libArcus is built with
+ * ENABLE_IO_URING, otherwise initialize() always fails and callers fall back to
+ * the regular BSD socket calls.
+ */
+class IoUring
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    /**
+     * Set up the submission and completion rings.
+     *
+     * This needs a kernel that can wait for completions with a timeout, which is Linux 5.11 or newer.
+     *
+     * \param entries The number of submissions that can be in flight at once.
+     *
+     * \return true if io_uring is available and was set up, false if not.
+     */
+    bool initialize(unsigned entries);
+
+    /**
+     * \return true if the ring was set up successfully.
+     */
+    bool isValid() const;
+
+    /**
+     * Send a list of buffers over a socket, in order, using a single system call.
+     *
+     * The buffers are split into linked submissions of at most IOV_MAX buffers each.
+     * While they are in flight, keep_waiting is called every 250 milliseconds, like a
+     * blocking send with a send timeout would wake up. Once it returns false, the sends
+     * are cancelled.
+     *
+     * \param socket_id The socket to send on.
+     * \param vectors The buffers to send.
+     * \param count The number of buffers.
+     * \param keep_waiting Whether to keep waiting for sends that did not complete yet.
+     *
+     * \return The amount of bytes sent, which can be less than requested if the
+     *         kernel performed a short send, or -1 if nothing could be sent or the
+     *         sends were cancelled.
+     */
+    std::ptrdiff_t send(int socket_id, const iovec* vectors, std::size_t count, const std::function<bool()>& keep_waiting);
+
+private:
+    // Copy and assignment is not supported.
+    IoUring(const IoUring&);
+    IoUring& operator=(const IoUring& other);
+
+    // Ask the kernel to cancel the first count sends of the current call, as far as they did not complete yet.
+    void cancelSends(std::size_t count);
+
+    int _ring_fd;
+    unsigned _entries;
+
+    void* _submission_ring;
+    std::size_t _submission_ring_size;
+    void* _completion_ring;
+    std::size_t _completion_ring_size;
+    void* _submission_entries;
+    std::size_t _submission_entries_size;
+
+    unsigned* _submission_tail;
+    unsigned* _submission_mask;
+    unsigned* _submission_array;
+    unsigned* _completion_head;
+    unsigned* _completion_tail;
+    unsigned* _completion_mask;
+    void* _completion_entries;
+};
+} // namespace Private
+} // namespace Arcus
+
+#endif // ARCUS_IO_URING_P_H
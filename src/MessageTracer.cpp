@@ -0,0 +1,151 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "MessageTracer_p.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+using namespace Arcus::Private;
+
+namespace
+{
+constexpr auto relaxed = std::memory_order_relaxed;
+
+uint32_t currentThread()
+{
+    thread_local const uint32_t thread = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return thread;
+}
+
+struct Phase
+{
+    const char* name;
+    const char* category;
+    char phase; // 'b' begins an async slice, 'e' ends it.
+};
+} // namespace
+
+MessageTracer::MessageTracer(std::size_t event_capacity) : capacity(std::max<std::size_t>(event_capacity, 1)), slots(new Slot[capacity]), next(0)
+{
+    for (std::size_t i = 0; i < capacity; ++i)
+    {
+        slots[i].sequence.store(0, relaxed);
+    }
+}
+
+int64_t MessageTracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void MessageTracer::record(Event event, const void* message, uint32_t type_id, std::size_t size)
+{
+    record(event, message, type_id, size, now());
+}
+
+void MessageTracer::record(Event event, const void* message, uint32_t type_id, std::size_t size, int64_t time)
+{
+    const uint64_t index = next.fetch_add(1, relaxed);
+    Slot& slot = slots[index % capacity];
+
+    // Readers skip the slot while the sequence does not match, so they never see half an event.
+    slot.sequence.store(0, relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(time, relaxed);
+    slot.message.store(reinterpret_cast<uintptr_t>(message), relaxed);
+    slot.size.store(size, relaxed);
+    slot.type_id.store(type_id, relaxed);
+    slot.event.store(static_cast<uint32_t>(event), relaxed);
+    slot.thread.store(currentThread(), relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+void MessageTracer::write(std::ostream& stream) const
+{
+    struct Recorded
+    {
+        int64_t time;
+        uintptr_t message;
+        uint64_t size;
+        uint32_t type_id;
+        uint32_t event;
+        uint32_t thread;
+    };
+
+    const uint64_t end = next.load(std::memory_order_acquire);
+    const uint64_t begin = end > capacity ? end - capacity : 0;
+    std::vector<Recorded> events;
+    events.reserve(end - begin);
+    for (uint64_t index = begin; index < end; ++index)
+    {
+        const Slot& slot = slots[index % capacity];
+        if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+        {
+            continue;
+        }
+
+        Recorded recorded{ slot.time.load(relaxed), slot.message.load(relaxed), slot.size.load(relaxed), slot.type_id.load(relaxed), slot.event.load(relaxed), slot.thread.load(relaxed) };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(relaxed) == index + 1)
+        {
+            events.push_back(recorded);
+        }
+    }
+
+    // Threads record concurrently, so the order in the buffer is only roughly by time.
+    std::stable_sort(events.begin(), events.end(), [](const Recorded& a, const Recorded& b) { return a.time < b.time; });
+    const int64_t origin = events.empty() ? 0 : events.front().time;
+
+    stream << "{\"traceEvents\":[";
+    bool first = true;
+    for (const Recorded& recorded : events)
+    {
+        std::vector<Phase> phases;
+        switch (static_cast<Event>(recorded.event))
+        {
+        case Event::Queued:
+            phases = { { "queued", "send", 'b' } };
+            break;
+        case Event::WriteStart:
+            phases = { { "queued", "send", 'e' }, { "write", "send", 'b' } };
+            break;
+        case Event::WriteEnd:
+            phases = { { "write", "send", 'e' } };
+            break;
+        case Event::FrameComplete:
+            phases = { { "parse", "receive", 'b' } };
+            break;
+        case Event::Parsed:
+            phases = { { "parse", "receive", 'e' }, { "waiting", "receive", 'b' } };
+            break;
+        case Event::Taken:
+            phases = { { "waiting", "receive", 'e' } };
+            break;
+        }
+
+        char timestamp[32];
+        std::snprintf(timestamp, sizeof(timestamp), "%.3f", static_cast<double>(recorded.time - origin) / 1000.0);
+        char id[32];
+        std::snprintf(id, sizeof(id), "0x%llx", static_cast<unsigned long long>(recorded.message));
+
+        for (const Phase& phase : phases)
+        {
+            stream << (first ? "" : ",") << "\n{\"name\":\"" << phase.name << "\",\"cat\":\"" << phase.category << "\",\"ph\":\"" << phase.phase << "\",\"id\":\"" << id
+                   << "\",\"ts\":" << timestamp << ",\"pid\":1,\"tid\":" << recorded.thread;
+            // The type and size are recorded once per stage, the viewer shows them for the whole slice.
+            if (recorded.type_id != 0)
+            {
+                stream << ",\"args\":{\"type_id\":" << recorded.type_id << ",\"size\":" << recorded.size << "}";
+            }
+            stream << "}";
+            first = false;
+        }
+    }
+    stream << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
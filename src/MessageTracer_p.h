@@ -0,0 +1,80 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_MESSAGE_TRACER_P_H
+#define ARCUS_MESSAGE_TRACER_P_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+namespace Arcus
+{
+namespace Private
+{
+/**
+ * Records when messages pass the stages of a socket, for Socket::enableTracing().
+ *
+ * Events go into a fixed ring buffer that any thread can write to without locking.
+ * Once full, the oldest events are overwritten.
+ */
+class MessageTracer
+{
+public:
+    enum class Event : uint32_t
+    {
+        Queued, ///< The application queued the message to be sent.
+        WriteStart, ///< The worker started writing the frame.
+        WriteEnd, ///< The frame was handed to the kernel, or the peer for in-process connections.
+        FrameComplete, ///< The last byte of a frame arrived.
+        Parsed, ///< The message was parsed and is about to be queued.
+        Taken ///< The application took the message.
+    };
+
+    explicit MessageTracer(std::size_t event_capacity);
+
+    /**
+     * Record an event.
+     *
+     * \param event What happened.
+     * \param message Identifies the message across its events.
+     * \param type_id The type ID of the message.
+     * \param size The serialized size of the message, if known.
+     * \param time When it happened, in nanoseconds of the steady clock.
+     */
+    void record(Event event, const void* message, uint32_t type_id, std::size_t size, int64_t time);
+    void record(Event event, const void* message, uint32_t type_id, std::size_t size);
+
+    /**
+     * Write the recorded events in the Chrome trace event format, which Perfetto also reads.
+     *
+     * Each message shows up as async slices for the time it spent queued, being written,
+     * being parsed and waiting to be taken.
+     */
+    void write(std::ostream& stream) const;
+
+    static int64_t now();
+
+private:
+    struct Slot
+    {
+        // The index of the event in the slot plus 1, 0 while it is being written.
+        std::atomic<uint64_t> sequence;
+        std::atomic<int64_t> time;
+        std::atomic<uintptr_t> message;
+        std::atomic<uint64_t> size;
+        std::atomic<uint32_t> type_id;
+        std::atomic<uint32_t> event;
+        std::atomic<uint32_t> thread;
+    };
+
+    const std::size_t capacity;
+    const std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> next;
+};
+} // namespace Private
+} // namespace Arcus
+
+#endif // ARCUS_MESSAGE_TRACER_P_H
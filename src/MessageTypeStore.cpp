@@ -3,33 +3,33 @@
 
 #include "Arcus/MessageTypeStore.h"
 
+#include <algorithm>
+#include <climits>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <google/protobuf/compiler/importer.h>
+#include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/dynamic_message.h>
 
 using namespace Arcus;
 
 /**
- * Taken from libstdc++, this implements hashing a string to an int.
+ * Hash a type name to its type ID, using the FNV-1a hash of typeId().
  *
  * Since we rely on the hashing method for type ID generation and the implementation
  * of std::hash differs between compilers, we need to make sure we use the same
- * implementation everywhere.
+ * implementation everywhere. typeId() is in the public header so type IDs can also
+ * be computed at compile time.
  */
 uint32_t hash(const std::string_view& input)
 {
-    const char* data = input.data();
-    size_t length = input.size();
-    uint32_t result = static_cast<uint32_t>(2166136261UL);
-    for (; length; --length)
-    {
-        result ^= static_cast<uint32_t>(*data++);
-        result *= static_cast<uint32_t>(16777619UL);
-    }
-    return result;
+    return typeId(input);
 }
 
 class ErrorCollector : public google::protobuf::compiler::MultiFileErrorCollector
@@ -61,34 +61,386 @@ private:
     int _error_count;
 };
 
+/**
+ * A lookup table that is built once, after all types are registered.
+ *
+ * Keys are spread with a multiplicative hash and the table is grown until no two
+ * keys share a slot, so a lookup reads a single slot. Should no such table be found
+ * within a reasonable size, it falls back to a binary search over the sorted keys.
+ *
+ * Empty slots hold a default constructed value, which is what a failed lookup returns.
+ */
+template<typename Key, typename Value>
+class FrozenTable
+{
+public:
+    FrozenTable() : shift(64), multiplier(0)
+    {
+    }
+
+    void build(std::vector<std::pair<Key, Value>> entries)
+    {
+        clear();
+
+        const std::size_t maximum_size = std::max<std::size_t>(64, entries.size() * 64);
+        for (std::size_t size = 2; size <= maximum_size; size *= 2)
+        {
+            if (size < entries.size() * 2)
+            {
+                continue;
+            }
+
+            unsigned bits = 0;
+            while ((std::size_t(1) << bits) < size)
+            {
+                ++bits;
+            }
+
+            for (uint64_t attempt = 0; attempt < 8; ++attempt)
+            {
+                const uint64_t candidate = 0x9E3779B97F4A7C15ull + attempt * 2;
+                std::vector<Slot> candidate_slots(size);
+                std::vector<bool> used(size, false);
+                bool collision = false;
+                for (const auto& entry : entries)
+                {
+                    const std::size_t index = slotIndex(entry.first, candidate, 64 - bits);
+                    if (used[index])
+                    {
+                        collision = true;
+                        break;
+                    }
+                    used[index] = true;
+                    candidate_slots[index] = { entry.first, entry.second };
+                }
+
+                if (! collision)
+                {
+                    slots.swap(candidate_slots);
+                    multiplier = candidate;
+                    shift = 64 - bits;
+                    return;
+                }
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return a.first < b.first; });
+        for (const auto& entry : entries)
+        {
+            sorted.push_back({ entry.first, entry.second });
+        }
+    }
+
+    void clear()
+    {
+        slots.clear();
+        sorted.clear();
+        shift = 64;
+        multiplier = 0;
+    }
+
+    Value find(Key key) const
+    {
+        if (! slots.empty())
+        {
+            const Slot& slot = slots[slotIndex(key, multiplier, shift)];
+            return slot.key == key ? slot.value : Value();
+        }
+
+        auto entry = std::lower_bound(sorted.begin(), sorted.end(), key, [](const Slot& slot, Key value) { return slot.key < value; });
+        return entry != sorted.end() && entry->key == key ? entry->value : Value();
+    }
+
+private:
+    struct Slot
+    {
+        Key key = Key();
+        Value value = Value();
+    };
+
+    static uint64_t toInteger(uint32_t key)
+    {
+        return key;
+    }
+
+    static uint64_t toInteger(const void* key)
+    {
+        // Descriptors are allocated with at least this alignment, so the low bits carry no information.
+        return reinterpret_cast<uintptr_t>(key) >> 4;
+    }
+
+    static std::size_t slotIndex(Key key, uint64_t multiplier, unsigned shift)
+    {
+        return shift >= 64 ? 0 : static_cast<std::size_t>((toInteger(key) * multiplier) >> shift);
+    }
+
+    std::vector<Slot> slots;
+    std::vector<Slot> sorted;
+    unsigned shift;
+    uint64_t multiplier;
+};
+
 class MessageTypeStore::Private
 {
 public:
+    Private() : frozen(false), use_generated_types(true)
+    {
+    }
+
+    // Look up the prototype for a type ID, in the frozen table if there is one.
+    const google::protobuf::Message* findPrototype(uint32_t type_id) const
+    {
+        if (frozen)
+        {
+            return frozen_types.find(type_id);
+        }
+
+        auto type = message_types.find(type_id);
+        return type != message_types.end() ? type->second : nullptr;
+    }
+
     std::unordered_map<uint, const google::protobuf::Message*> message_types;
     std::unordered_map<const google::protobuf::Descriptor*, uint> message_type_mapping;
 
+    // Flat copies of the maps above for the lookups done for every message, built by freeze().
+    bool frozen;
+    FrozenTable<uint32_t, const google::protobuf::Message*> frozen_types;
+    FrozenTable<const google::protobuf::Descriptor*, uint32_t> frozen_type_mapping;
+
     std::shared_ptr<ErrorCollector> error_collector;
     std::shared_ptr<google::protobuf::compiler::DiskSourceTree> source_tree;
     std::shared_ptr<google::protobuf::compiler::Importer> importer;
     std::shared_ptr<google::protobuf::DynamicMessageFactory> message_factory;
+    // Holds the files loaded from precompiled descriptor sets.
+    std::shared_ptr<google::protobuf::DescriptorPool> descriptor_pool;
+
+    // Whether types loaded at runtime are bound to generated classes linked into the binary.
+    bool use_generated_types;
+
+    bool registerDescriptorSet(const std::string& source, const char* data, std::size_t size);
+    void registerDescriptor(const google::protobuf::Descriptor* descriptor);
 };
 
-Arcus::MessageTypeStore::MessageTypeStore() : d(new Private)
+// Descriptor sets written by protoc have JSON names filled in while generated code may not, so leave them out of comparisons.
+void clearJsonNames(google::protobuf::DescriptorProto& definition)
 {
+    for (auto& field : *definition.mutable_field())
+    {
+        field.clear_json_name();
+    }
+    for (auto& field : *definition.mutable_extension())
+    {
+        field.clear_json_name();
+    }
+    for (auto& nested : *definition.mutable_nested_type())
+    {
+        clearJsonNames(nested);
+    }
 }
 
-Arcus::MessageTypeStore::~MessageTypeStore()
+// Is an enum loaded at runtime defined the same as the generated one of the same name?
+bool matchesGenerated(const google::protobuf::EnumDescriptor* descriptor)
 {
+    const google::protobuf::EnumDescriptor* generated = google::protobuf::DescriptorPool::generated_pool()->FindEnumTypeByName(descriptor->full_name());
+    if (! generated)
+    {
+        return false;
+    }
+
+    google::protobuf::EnumDescriptorProto loaded_definition;
+    google::protobuf::EnumDescriptorProto generated_definition;
+    descriptor->CopyTo(&loaded_definition);
+    generated->CopyTo(&generated_definition);
+    return loaded_definition.SerializeAsString() == generated_definition.SerializeAsString();
 }
 
-bool Arcus::MessageTypeStore::hasType(uint32_t type_id) const
+bool matchesGenerated(const google::protobuf::Descriptor* descriptor, std::unordered_set<const google::protobuf::Descriptor*>& compared);
+
+// Do the types the fields of a message refer to match their generated ones? Includes the fields of nested types.
+bool referencesMatchGenerated(const google::protobuf::Descriptor* descriptor, std::unordered_set<const google::protobuf::Descriptor*>& compared)
 {
-    if (d->message_types.find(type_id) != d->message_types.end())
+    for (int i = 0; i < descriptor->field_count(); ++i)
+    {
+        const google::protobuf::FieldDescriptor* field = descriptor->field(i);
+        if (field->message_type() && ! matchesGenerated(field->message_type(), compared))
+        {
+            return false;
+        }
+        if (field->enum_type() && ! matchesGenerated(field->enum_type()))
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < descriptor->nested_type_count(); ++i)
+    {
+        if (! referencesMatchGenerated(descriptor->nested_type(i), compared))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Is a message loaded at runtime defined the same as the generated one of the same name, including every type it refers to?
+// compared holds the types that were already compared, so types that refer to each other are only compared once.
+bool matchesGenerated(const google::protobuf::Descriptor* descriptor, std::unordered_set<const google::protobuf::Descriptor*>& compared)
+{
+    if (! compared.insert(descriptor).second)
     {
         return true;
     }
 
-    return false;
+    const google::protobuf::Descriptor* generated = google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(descriptor->full_name());
+    if (! generated)
+    {
+        return false;
+    }
+
+    google::protobuf::DescriptorProto loaded_definition;
+    google::protobuf::DescriptorProto generated_definition;
+    descriptor->CopyTo(&loaded_definition);
+    generated->CopyTo(&generated_definition);
+    clearJsonNames(loaded_definition);
+    clearJsonNames(generated_definition);
+    if (loaded_definition.SerializeAsString() != generated_definition.SerializeAsString())
+    {
+        return false;
+    }
+
+    return referencesMatchGenerated(descriptor, compared);
+}
+
+/**
+ * Find the generated class for a type loaded at runtime, if it is linked into the binary.
+ *
+ * The class is only used if it was generated from the same definition, so a protocol
+ * file that changed since the binary was built still gets the type as it is in the file.
+ * The same goes for every message and enum it refers to, since the generated class
+ * parses those with their generated definitions as well.
+ */
+const google::protobuf::Message* findGeneratedPrototype(const google::protobuf::Descriptor* descriptor)
+{
+    std::unordered_set<const google::protobuf::Descriptor*> compared;
+    if (! matchesGenerated(descriptor, compared))
+    {
+        return nullptr;
+    }
+
+    const google::protobuf::Descriptor* generated = google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(descriptor->full_name());
+    return google::protobuf::MessageFactory::generated_factory()->GetPrototype(generated);
+}
+
+// Register a type loaded at runtime, preferring its generated class over a dynamic message.
+void MessageTypeStore::Private::registerDescriptor(const google::protobuf::Descriptor* descriptor)
+{
+    const google::protobuf::Message* message_type = use_generated_types ? findGeneratedPrototype(descriptor) : nullptr;
+    if (! message_type)
+    {
+        if (! message_factory)
+        {
+            message_factory = std::make_shared<google::protobuf::DynamicMessageFactory>();
+        }
+        message_type = message_factory->GetPrototype(descriptor);
+    }
+
+    uint32_t type_id = hash(message_type->GetTypeName());
+#ifdef ARCUS_DEBUG
+    std::cerr << message_type->GetTypeName() << ": " << type_id << std::endl;
+#endif // ARCUS_DEBUG
+
+    message_types[type_id] = message_type;
+    message_type_mapping[message_type->GetDescriptor()] = type_id;
+}
+
+// Build the files of a serialized FileDescriptorSet and register the message types of its last file.
+// protoc writes the imports of a file before it, so the last file is the one the set was made for.
+bool MessageTypeStore::Private::registerDescriptorSet(const std::string& source, const char* data, std::size_t size)
+{
+    if (! error_collector)
+    {
+        error_collector = std::make_shared<ErrorCollector>();
+    }
+
+    google::protobuf::FileDescriptorSet descriptor_set;
+    if (size > INT_MAX || ! descriptor_set.ParseFromArray(data, static_cast<int>(size)))
+    {
+        error_collector->RecordError(source, 0, 0, "Not a valid descriptor set");
+        return false;
+    }
+    if (descriptor_set.file_size() == 0)
+    {
+        error_collector->RecordError(source, 0, 0, "The descriptor set contains no files");
+        return false;
+    }
+
+    if (! descriptor_pool)
+    {
+        descriptor_pool = std::make_shared<google::protobuf::DescriptorPool>();
+    }
+
+    std::vector<const google::protobuf::FileDescriptorProto*> remaining;
+    for (const auto& file : descriptor_set.file())
+    {
+        if (! descriptor_pool->FindFileByName(file.name()))
+        {
+            remaining.push_back(&file);
+        }
+    }
+
+    // protoc writes dependencies before the files that import them, but do not depend on that.
+    bool progress = true;
+    while (! remaining.empty() && progress)
+    {
+        progress = false;
+        for (auto file = remaining.begin(); file != remaining.end();)
+        {
+            const auto& dependencies = (*file)->dependency();
+            const bool ready = std::all_of(dependencies.begin(), dependencies.end(), [this](const std::string& dependency) { return descriptor_pool->FindFileByName(dependency) != nullptr; });
+            if (! ready)
+            {
+                ++file;
+                continue;
+            }
+
+            const google::protobuf::FileDescriptor* descriptor = descriptor_pool->BuildFile(**file);
+            if (! descriptor)
+            {
+                error_collector->RecordError((*file)->name(), 0, 0, "Could not build the file from the descriptor set");
+                return false;
+            }
+            file = remaining.erase(file);
+            progress = true;
+        }
+    }
+
+    if (! remaining.empty())
+    {
+        error_collector->RecordError(remaining.front()->name(), 0, 0, "Imports a file that is not part of the descriptor set");
+        return false;
+    }
+
+    // Like registerAllMessageTypes(), the imported files only provide the types this file uses.
+    const google::protobuf::FileDescriptor* requested = descriptor_pool->FindFileByName(descriptor_set.file(descriptor_set.file_size() - 1).name());
+    for (int i = 0; i < requested->message_type_count(); ++i)
+    {
+        registerDescriptor(requested->message_type(i));
+    }
+    frozen = false;
+
+    return true;
+}
+
+Arcus::MessageTypeStore::MessageTypeStore() : d(new Private)
+{
+}
+
+Arcus::MessageTypeStore::~MessageTypeStore()
+{
+}
+
+bool Arcus::MessageTypeStore::hasType(uint32_t type_id) const
+{
+    return d->findPrototype(type_id) != nullptr;
 }
 
 bool Arcus::MessageTypeStore::hasType(const std::string& type_name) const
@@ -99,12 +451,13 @@ bool Arcus::MessageTypeStore::hasType(const std::string& type_name) const
 
 MessagePtr Arcus::MessageTypeStore::createMessage(uint32_t type_id) const
 {
-    if (! hasType(type_id))
+    const google::protobuf::Message* prototype = d->findPrototype(type_id);
+    if (! prototype)
     {
         return MessagePtr();
     }
 
-    return MessagePtr(d->message_types[type_id]->New());
+    return MessagePtr(prototype->New());
 }
 
 MessagePtr Arcus::MessageTypeStore::createMessage(const std::string& type_name) const
@@ -113,13 +466,65 @@ MessagePtr Arcus::MessageTypeStore::createMessage(const std::string& type_name)
     return createMessage(type_id);
 }
 
-uint32_t Arcus::MessageTypeStore::getMessageTypeId(const MessagePtr& message)
+uint32_t Arcus::MessageTypeStore::getMessageTypeId(const MessagePtr& message) const
 {
+    // Registered types are looked up by descriptor, which avoids building and hashing the type name for every message.
+    if (d->frozen)
+    {
+        const uint32_t type_id = d->frozen_type_mapping.find(message->GetDescriptor());
+        return type_id != 0 ? type_id : hash(message->GetTypeName());
+    }
+
+    auto type = d->message_type_mapping.find(message->GetDescriptor());
+    if (type != d->message_type_mapping.end())
+    {
+        return type->second;
+    }
+
     return hash(message->GetTypeName());
 }
 
+void Arcus::MessageTypeStore::freeze()
+{
+    if (d->frozen)
+    {
+        return;
+    }
+
+    std::vector<std::pair<uint32_t, const google::protobuf::Message*>> types(d->message_types.begin(), d->message_types.end());
+    d->frozen_types.build(types);
+
+    std::vector<std::pair<const google::protobuf::Descriptor*, uint32_t>> mapping(d->message_type_mapping.begin(), d->message_type_mapping.end());
+    d->frozen_type_mapping.build(mapping);
+
+    // Protobuf builds the tables to parse and serialize a type through reflection when they are
+    // first needed. Do that now for all types, rather than while handling the first message.
+    for (const auto& type : d->message_types)
+    {
+        std::unique_ptr<google::protobuf::Message> message(type.second->New());
+        message->ParseFromString(std::string());
+        message->SerializeAsString();
+    }
+
+    d->frozen = true;
+}
+
+bool Arcus::MessageTypeStore::isFrozen() const
+{
+    return d->frozen;
+}
+
+void Arcus::MessageTypeStore::setUseGeneratedTypes(bool use_generated_types)
+{
+    d->use_generated_types = use_generated_types;
+}
+
 std::string Arcus::MessageTypeStore::getErrorMessages() const
 {
+    if (! d->error_collector)
+    {
+        return std::string();
+    }
     return d->error_collector->getAllErrors();
 }
 
@@ -138,6 +543,7 @@ bool Arcus::MessageTypeStore::registerMessageType(const google::protobuf::Messag
 
     d->message_types[type_id] = message_type;
     d->message_type_mapping[message_type->GetDescriptor()] = type_id;
+    d->frozen = false;
 
     return true;
 }
@@ -177,28 +583,42 @@ bool Arcus::MessageTypeStore::registerAllMessageTypes(const std::string& file_na
         return false;
     }
 
-    if (! d->message_factory)
+    for (int i = 0; i < descriptor->message_type_count(); ++i)
     {
-        d->message_factory = std::make_shared<google::protobuf::DynamicMessageFactory>();
+        d->registerDescriptor(descriptor->message_type(i));
     }
+    d->frozen = false;
 
-    for (int i = 0; i < descriptor->message_type_count(); ++i)
-    {
-        auto message_type_descriptor = descriptor->message_type(i);
-        auto message_type = d->message_factory->GetPrototype(message_type_descriptor);
-        uint32_t type_id = hash(message_type->GetTypeName());
+    return true;
+}
+
+bool Arcus::MessageTypeStore::registerAllMessageTypesFromDescriptorSet(const std::string& file_name)
+{
 #ifdef ARCUS_DEBUG
-        std::cerr << message_type->GetTypeName() << ": " << type_id << std::endl;
+    std::cerr << "Reading message descriptors from: " << file_name << std::endl;
 #endif // ARCUS_DEBUG
 
-        d->message_types[type_id] = message_type;
-        d->message_type_mapping[message_type_descriptor] = type_id;
+    std::ifstream file(file_name, std::ios::binary);
+    if (! file)
+    {
+        if (! d->error_collector)
+        {
+            d->error_collector = std::make_shared<ErrorCollector>();
+        }
+        d->error_collector->RecordError(file_name, 0, 0, "Could not open the descriptor set");
+        return false;
     }
 
-    return true;
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return d->registerDescriptorSet(file_name, data.data(), data.size());
+}
+
+bool Arcus::MessageTypeStore::registerAllMessageTypesFromDescriptorSet(const char* data, std::size_t size)
+{
+    return d->registerDescriptorSet("embedded descriptor set", data, size);
 }
 
-void Arcus::MessageTypeStore::dumpMessageTypes()
+void Arcus::MessageTypeStore::dumpMessageTypes() const
 {
     for (auto type : d->message_types)
     {
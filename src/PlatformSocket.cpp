@@ -9,14 +9,23 @@
 #else
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0x0 // Don't request NOSIGNAL on systems where this is not implemented.
 #endif
@@ -55,7 +64,61 @@ sockaddr_in createAddress(const std::string& address, uint16_t port)
     return a;
 }
 
-Arcus::Private::PlatformSocket::PlatformSocket()
+// The platform's description of a block of data to write, and accessors that work the same for each platform.
+#ifdef _WIN32
+typedef WSABUF PlatformBuffer;
+
+void setBuffer(WSABUF& buffer, const char* data, std::size_t size)
+{
+    buffer.buf = const_cast<char*>(data);
+    buffer.len = static_cast<ULONG>(size);
+}
+
+const char* bufferData(const WSABUF& buffer)
+{
+    return buffer.buf;
+}
+
+std::size_t bufferSize(const WSABUF& buffer)
+{
+    return buffer.len;
+}
+#else
+typedef iovec PlatformBuffer;
+
+void setBuffer(iovec& buffer, const char* data, std::size_t size)
+{
+    buffer.iov_base = const_cast<char*>(data);
+    buffer.iov_len = size;
+}
+
+const char* bufferData(const iovec& buffer)
+{
+    return static_cast<const char*>(buffer.iov_base);
+}
+
+std::size_t bufferSize(const iovec& buffer)
+{
+    return buffer.iov_len;
+}
+#endif
+
+// Wait for one of the poll events on a socket.
+bool waitForEvent(int socket_id, short events, int timeout)
+{
+    pollfd descriptor;
+    descriptor.fd = socket_id;
+    descriptor.events = events;
+    descriptor.revents = 0;
+#ifdef _WIN32
+    int result = ::WSAPoll(&descriptor, 1, timeout);
+#else
+    int result = ::poll(&descriptor, 1, timeout);
+#endif
+    return result > 0 && (descriptor.revents & (events | POLLERR | POLLHUP)) != 0;
+}
+
+Arcus::Private::PlatformSocket::PlatformSocket() : _socket_id(-1), _partial_word(0), _partial_size(0), _blocking(true), _write_deadline(0), _use_io_uring(false)
 {
 #ifdef _WIN32
     initializeWSA();
@@ -69,9 +132,51 @@ Arcus::Private::PlatformSocket::~PlatformSocket()
 bool Arcus::Private::PlatformSocket::create()
 {
     _socket_id = ::socket(AF_INET, SOCK_STREAM, 0);
+    _partial_size = 0;
+    _blocking = true;
+    _write_deadline = 0;
     return _socket_id != -1;
 }
 
+bool Arcus::Private::PlatformSocket::createNotifier()
+{
+    // A datagram socket connected to itself, so a byte sent to it makes it readable.
+    // This works with poll() everywhere, unlike pipes or eventfd.
+    _socket_id = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (_socket_id == -1)
+    {
+        return false;
+    }
+
+    sockaddr_in address = createAddress("127.0.0.1", 0);
+    socklen_t length = sizeof(address);
+    if (::bind(_socket_id, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ::getsockname(_socket_id, reinterpret_cast<sockaddr*>(&address), &length) != 0
+        || ::connect(_socket_id, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ! setBlocking(false))
+    {
+        close();
+        _socket_id = -1;
+        return false;
+    }
+    return true;
+}
+
+void Arcus::Private::PlatformSocket::notify()
+{
+    // When the buffer is full, there already are notifications waiting, so a failure does not matter.
+    const char signal = 1;
+    ::send(_socket_id, &signal, 1, MSG_NOSIGNAL);
+}
+
+void Arcus::Private::PlatformSocket::clearNotifications()
+{
+    char buffer[64];
+    while (::recv(_socket_id, buffer, sizeof(buffer), 0) > 0)
+    {
+    }
+}
+
 bool Arcus::Private::PlatformSocket::connect(const std::string& address, uint16_t port)
 {
     auto address_data = createAddress(address, port);
@@ -96,6 +201,12 @@ bool Arcus::Private::PlatformSocket::accept()
 {
     int new_socket = ::accept(_socket_id, 0, 0);
 
+    if (new_socket == -1 && wouldBlock())
+    {
+        // A non-blocking socket without waiting connections, keep listening.
+        return false;
+    }
+
 #ifdef _WIN32
     ::closesocket(_socket_id);
 #else
@@ -109,10 +220,28 @@ bool Arcus::Private::PlatformSocket::accept()
     else
     {
         _socket_id = new_socket;
+        _partial_size = 0;
+        _blocking = true;
+        _write_deadline = 0;
         return true;
     }
 }
 
+bool Arcus::Private::PlatformSocket::acceptConnection(PlatformSocket& connection)
+{
+    int new_socket = ::accept(_socket_id, 0, 0);
+    if (new_socket == -1)
+    {
+        return false;
+    }
+
+    connection._socket_id = new_socket;
+    connection._partial_size = 0;
+    connection._blocking = true;
+    connection._write_deadline = 0;
+    return true;
+}
+
 bool Arcus::Private::PlatformSocket::close()
 {
     int result = 0;
@@ -122,6 +251,7 @@ bool Arcus::Private::PlatformSocket::close()
     result = ::close(_socket_id);
 #endif
 
+    _partial_size = 0;
     return result == 0;
 }
 
@@ -159,6 +289,7 @@ void Arcus::Private::PlatformSocket::flush()
 {
     char* buffer = new char[256];
     socket_size num = 0;
+    _partial_size = 0;
 
     while (num > 0)
     {
@@ -169,13 +300,106 @@ void Arcus::Private::PlatformSocket::flush()
 socket_size Arcus::Private::PlatformSocket::writeUInt32(uint32_t data)
 {
     uint32_t temp = htonl(data);
-    socket_size sent_size = ::send(_socket_id, reinterpret_cast<const char*>(&temp), 4, MSG_NOSIGNAL);
-    return sent_size;
+    // The other side cannot make sense of part of a word, so anything less than all of it is a failure.
+    return writeBytes(4, reinterpret_cast<const char*>(&temp)) == 4 ? 4 : -1;
 }
 
 socket_size Arcus::Private::PlatformSocket::writeBytes(std::size_t size, const char* data)
 {
-    return ::send(_socket_id, data, size, MSG_NOSIGNAL);
+    // A blocking write that hit the send timeout may have sent only part of the data, the rest follows.
+    std::size_t total_size = 0;
+    do
+    {
+        socket_size sent_size = ::send(_socket_id, data + total_size, size - total_size, MSG_NOSIGNAL);
+        if (sent_size < 0)
+        {
+            if (canRetryWrite())
+            {
+                continue;
+            }
+            return total_size > 0 && ! _blocking ? static_cast<socket_size>(total_size) : -1;
+        }
+        total_size += static_cast<std::size_t>(sent_size);
+    } while (_blocking && total_size < size);
+    return static_cast<socket_size>(total_size);
+}
+
+socket_size Arcus::Private::PlatformSocket::writeBuffers(const WriteBuffer* buffers, std::size_t count)
+{
+    std::vector<PlatformBuffer> vectors(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        setBuffer(vectors[i], buffers[i].data, buffers[i].size);
+    }
+
+#ifndef _WIN32
+    if (_use_io_uring && ! _io_uring)
+    {
+        _io_uring = std::make_unique<IoUring>();
+        if (! _io_uring->initialize(8))
+        {
+            // Not built in or not supported by this kernel, stick to the regular calls from now on.
+            _use_io_uring = false;
+        }
+    }
+#endif
+
+    // Keep writing until everything is sent, like send() on a blocking socket would.
+    socket_size total_size = 0;
+    std::size_t first = 0;
+    while (first < count)
+    {
+        socket_size sent_size = 0;
+#ifdef _WIN32
+        DWORD sent = 0;
+        if (::WSASend(_socket_id, &vectors[first], static_cast<DWORD>(count - first), &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+        {
+            sent_size = -1;
+        }
+        else
+        {
+            sent_size = static_cast<socket_size>(sent);
+        }
+#else
+        if (isUsingIoUring())
+        {
+            // The ring waits for the sends itself, giving up once the write deadline passed.
+            sent_size = _io_uring->send(_socket_id, &vectors[first], count - first, [this]() { return beforeWriteDeadline(); });
+        }
+        else
+        {
+            msghdr message;
+            std::memset(&message, 0, sizeof(message));
+            message.msg_iov = &vectors[first];
+            message.msg_iovlen = std::min<std::size_t>(count - first, IOV_MAX);
+            sent_size = ::sendmsg(_socket_id, &message, MSG_NOSIGNAL);
+        }
+#endif
+
+        if (sent_size < 0)
+        {
+            if (canRetryWrite())
+            {
+                continue;
+            }
+            // Part of a frame may have been sent, after which the framing of the connection is lost.
+            return -1;
+        }
+        total_size += sent_size;
+
+        // Skip the blocks that were sent completely and adjust a partially sent one.
+        std::size_t remaining = static_cast<std::size_t>(sent_size);
+        while (first < count && remaining >= bufferSize(vectors[first]))
+        {
+            remaining -= bufferSize(vectors[first]);
+            ++first;
+        }
+        if (first < count)
+        {
+            setBuffer(vectors[first], bufferData(vectors[first]) + remaining, bufferSize(vectors[first]) - remaining);
+        }
+    }
+    return total_size;
 }
 
 socket_size Arcus::Private::PlatformSocket::readUInt32(uint32_t* output)
@@ -184,8 +408,23 @@ socket_size Arcus::Private::PlatformSocket::readUInt32(uint32_t* output)
     errno = 0;
 #endif
 
-    uint32_t buffer;
-    socket_size num = ::recv(_socket_id, reinterpret_cast<char*>(&buffer), 4, 0);
+    // Bytes of an integer that arrived partially are kept until the rest arrives, so a partial read cannot break the framing.
+    char* buffer = reinterpret_cast<char*>(&_partial_word);
+#ifdef _WIN32
+    socket_size num = ::recv(_socket_id, buffer + _partial_size, static_cast<int>(4 - _partial_size), 0);
+#else
+    socket_size num = ::recv(_socket_id, buffer + _partial_size, 4 - _partial_size, 0);
+#endif
+    if (num > 0)
+    {
+        _partial_size += static_cast<std::size_t>(num);
+        if (_partial_size < 4)
+        {
+            return 0;
+        }
+        _partial_size = 0;
+        num = 4;
+    }
 
     if (num != 4)
     {
@@ -208,7 +447,7 @@ socket_size Arcus::Private::PlatformSocket::readUInt32(uint32_t* output)
         return -1;
     }
 
-    *output = ntohl(buffer);
+    *output = ntohl(_partial_word);
     return num;
 }
 
@@ -250,6 +489,181 @@ bool Arcus::Private::PlatformSocket::setReceiveTimeout(int timeout)
 #endif
 }
 
+bool Arcus::Private::PlatformSocket::setSendTimeout(int timeout)
+{
+#ifdef _WIN32
+    return ::setsockopt(_socket_id, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) != SOCKET_ERROR;
+#else
+    timeval t;
+    t.tv_sec = timeout / 1000;
+    t.tv_usec = (timeout % 1000) * 1000;
+    return ::setsockopt(_socket_id, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&t), sizeof(t)) == 0;
+#endif
+}
+
+bool Arcus::Private::PlatformSocket::setBlocking(bool blocking)
+{
+#ifdef _WIN32
+    u_long mode = blocking ? 0 : 1;
+    if (::ioctlsocket(_socket_id, FIONBIO, &mode) != 0)
+    {
+        return false;
+    }
+    _blocking = blocking;
+    return true;
+#else
+    int flags = ::fcntl(_socket_id, F_GETFL, 0);
+    if (flags == -1)
+    {
+        return false;
+    }
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    if (::fcntl(_socket_id, F_SETFL, flags) != 0)
+    {
+        return false;
+    }
+    _blocking = blocking;
+    return true;
+#endif
+}
+
+void Arcus::Private::PlatformSocket::setWriteDeadline(std::chrono::steady_clock::time_point deadline)
+{
+    _write_deadline = deadline.time_since_epoch().count();
+}
+
+bool Arcus::Private::PlatformSocket::canRetryWrite()
+{
+    // Only a blocking write that hit the send timeout is retried, non-blocking callers handle that themselves.
+#ifdef _WIN32
+    const bool timed_out = WSAGetLastError() == WSAETIMEDOUT || WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    const bool timed_out = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+    if (! _blocking || ! timed_out)
+    {
+        return false;
+    }
+
+    return beforeWriteDeadline();
+}
+
+bool Arcus::Private::PlatformSocket::beforeWriteDeadline() const
+{
+    const auto deadline = _write_deadline.load();
+    return deadline == 0 || std::chrono::steady_clock::now().time_since_epoch().count() < deadline;
+}
+
+bool Arcus::Private::PlatformSocket::waitForReadable(int timeout)
+{
+    return waitForEvent(_socket_id, POLLIN, timeout);
+}
+
+bool Arcus::Private::PlatformSocket::waitForWritable(int timeout)
+{
+    return waitForEvent(_socket_id, POLLOUT, timeout);
+}
+
+bool Arcus::Private::PlatformSocket::waitForAnyReadable(PlatformSocket* const* sockets, std::size_t count, int timeout, bool* readable)
+{
+    std::vector<pollfd> descriptors(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        descriptors[i].fd = sockets[i]->_socket_id;
+        descriptors[i].events = POLLIN;
+        descriptors[i].revents = 0;
+    }
+
+#ifdef _WIN32
+    int result = ::WSAPoll(descriptors.data(), static_cast<ULONG>(count), timeout);
+#else
+    int result = ::poll(descriptors.data(), static_cast<nfds_t>(count), timeout);
+#endif
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        readable[i] = result > 0 && (descriptors[i].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+    }
+    return result > 0;
+}
+
+bool Arcus::Private::PlatformSocket::setNoDelay(bool no_delay)
+{
+    int value = no_delay ? 1 : 0;
+    return ::setsockopt(_socket_id, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+}
+
+bool Arcus::Private::PlatformSocket::setSendBufferSize(int size)
+{
+    return ::setsockopt(_socket_id, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&size), sizeof(size)) == 0;
+}
+
+bool Arcus::Private::PlatformSocket::setReceiveBufferSize(int size)
+{
+    return ::setsockopt(_socket_id, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&size), sizeof(size)) == 0;
+}
+
+int Arcus::Private::PlatformSocket::getSendBufferSize()
+{
+    int size = 0;
+    socklen_t length = sizeof(size);
+    if (::getsockopt(_socket_id, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<char*>(&size), &length) != 0)
+    {
+        return -1;
+    }
+    return size;
+}
+
+int Arcus::Private::PlatformSocket::getReceiveBufferSize()
+{
+    int size = 0;
+    socklen_t length = sizeof(size);
+    if (::getsockopt(_socket_id, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char*>(&size), &length) != 0)
+    {
+        return -1;
+    }
+    return size;
+}
+
+bool Arcus::Private::PlatformSocket::setBusyPoll(int microseconds)
+{
+#ifdef SO_BUSY_POLL
+    return ::setsockopt(_socket_id, SOL_SOCKET, SO_BUSY_POLL, reinterpret_cast<const char*>(&microseconds), sizeof(microseconds)) == 0;
+#else
+    return microseconds == 0;
+#endif
+}
+
+bool Arcus::Private::PlatformSocket::setCorked(bool corked)
+{
+#ifdef TCP_CORK
+    int value = corked ? 1 : 0;
+    return ::setsockopt(_socket_id, IPPROTO_TCP, TCP_CORK, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+#else
+    return ! corked;
+#endif
+}
+
+int Arcus::Private::PlatformSocket::takePendingError()
+{
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (::getsockopt(_socket_id, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) != 0)
+    {
+        return getNativeErrorCode();
+    }
+    return error;
+}
+
+bool Arcus::Private::PlatformSocket::wouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+#endif
+}
+
 int Arcus::Private::PlatformSocket::getNativeErrorCode()
 {
 #ifdef _WIN32
@@ -258,3 +672,22 @@ int Arcus::Private::PlatformSocket::getNativeErrorCode()
     return errno;
 #endif
 }
+
+int Arcus::Private::PlatformSocket::getNativeHandle() const
+{
+    return _socket_id;
+}
+
+void Arcus::Private::PlatformSocket::setUseIoUring(bool use)
+{
+    _use_io_uring = use;
+    if (! use)
+    {
+        _io_uring.reset();
+    }
+}
+
+bool Arcus::Private::PlatformSocket::isUsingIoUring() const
+{
+    return _use_io_uring && _io_uring && _io_uring->isValid();
+}
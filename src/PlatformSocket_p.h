@@ -4,9 +4,13 @@
 #ifndef ARCUS_PLATFORM_SOCKET_P_H
 #define ARCUS_PLATFORM_SOCKET_P_H
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 
+#include "IoUring_p.h"
+
 namespace Arcus
 {
 namespace Private
@@ -17,6 +21,15 @@ typedef int socket_size;
 typedef ssize_t socket_size;
 #endif
 
+/**
+ * A block of data to write as part of a larger write.
+ */
+struct WriteBuffer
+{
+    const char* data;
+    std::size_t size;
+};
+
 /**
  * Private class that wraps the platform C API for dealing with Sockets.
  */
@@ -42,6 +55,20 @@ public:
      * \return true if socket creation was successful, false if not.
      */
     bool create();
+    /**
+     * Create a socket that only serves to wake up a thread waiting in waitForAnyReadable().
+     *
+     * \return true if successful, false if not.
+     */
+    bool createNotifier();
+    /**
+     * Make a notifier socket readable. Can be called from any thread.
+     */
+    void notify();
+    /**
+     * Make a notifier socket no longer readable.
+     */
+    void clearNotifications();
     /**
      * Connect to an IP address and port.
      *
@@ -76,6 +103,16 @@ public:
      * \note This call will block until there is a connection waiting to be accepted.
      */
     bool accept();
+    /**
+     * Accept the waiting incoming connection into another socket, while this one keeps listening.
+     *
+     * \param connection The socket that will represent the accepted connection.
+     *
+     * \return true if successful, false if not.
+     *
+     * \note This call will block until there is a connection waiting to be accepted.
+     */
+    bool acceptConnection(PlatformSocket& connection);
     /**
      * Close the socket.
      *
@@ -106,18 +143,36 @@ public:
      *
      * \param data The integer to write. Will be converted from local endianness to network endianness.
      *
-     * \return The amount of bytes written (4) or -1 if an error occurred.
+     * \return The amount of bytes written (4) or -1 if an error occurred. Since part of the
+     *         integer may have been written then, the connection can no longer be used.
      */
     socket_size writeUInt32(uint32_t data);
     /**
      * Write data to the the socket.
      *
+     * A blocking socket keeps writing until everything is sent, a non-blocking socket
+     * writes what fits without blocking.
+     *
      * \param size The amount of data to write.
      * \param data A pointer to the data to send.
      *
      * \return The amount of bytes written, or -1 if an error occurred.
      */
     socket_size writeBytes(std::size_t size, const char* data);
+    /**
+     * Write several blocks of data to the socket with as few system calls as possible.
+     *
+     * The blocks are written in order as if they were one contiguous block. When io_uring
+     * is enabled and available, it is used to submit them, otherwise this uses a single
+     * vectored send for up to IOV_MAX blocks.
+     *
+     * \param buffers The blocks of data to write.
+     * \param count The amount of blocks.
+     *
+     * \return The amount of bytes written, which is everything, or -1 if an error occurred.
+     *         Since part of the data may have been written then, the connection can no longer be used.
+     */
+    socket_size writeBuffers(const WriteBuffer* buffers, std::size_t count);
     /**
      * Read an unsigned 32-bit integer from the socket.
      *
@@ -125,7 +180,8 @@ public:
      *
      * \return The amount of bytes read (4) or -1 if an error occurred.
      *
-     * \note This call will block if the amount of data waiting to be read is less than 4.
+     * \note This call will block if no data is waiting to be read. If less than 4 bytes are
+     *       waiting, they are kept and 0 is returned so the call can be retried.
      */
     socket_size readUInt32(uint32_t* output);
     /**
@@ -150,13 +206,168 @@ public:
      * \param timeout The amount of time in milliseconds to wait for data.
      */
     bool setReceiveTimeout(int timeout);
+    /**
+     * Set the timeout for the write-related methods.
+     *
+     * Writes that cannot complete within this time, because the other side does not
+     * read, fail instead of blocking indefinitely.
+     *
+     * \param timeout The amount of time in milliseconds a write may block, 0 to block indefinitely.
+     *
+     * \return true if successful, false if not.
+     */
+    bool setSendTimeout(int timeout);
+    /**
+     * Give up on blocking writes after a point in time.
+     *
+     * Writes that hit the send timeout are retried until everything is written. After
+     * the deadline they fail instead. Since this is checked each time the send timeout
+     * expires, it can be called from any thread to end a write that blocks.
+     *
+     * \param deadline The time after which writes fail.
+     */
+    void setWriteDeadline(std::chrono::steady_clock::time_point deadline);
+    /**
+     * Switch the socket between blocking and non-blocking operation.
+     *
+     * \param blocking true to make calls block, false to make them return immediately.
+     *
+     * \return true if successful, false if not.
+     */
+    bool setBlocking(bool blocking);
+    /**
+     * Wait until the socket is readable.
+     *
+     * \param timeout The amount of time in milliseconds to wait, 0 to only check.
+     *
+     * \return true if the socket is readable, false if the timeout expired or an error occurred.
+     */
+    bool waitForReadable(int timeout);
+    /**
+     * Wait until the socket is writable.
+     *
+     * \param timeout The amount of time in milliseconds to wait, 0 to only check.
+     *
+     * \return true if the socket is writable, false if the timeout expired or an error occurred.
+     */
+    bool waitForWritable(int timeout);
+    /**
+     * Wait until at least one of several sockets is readable.
+     *
+     * \param sockets The sockets to wait on.
+     * \param count The amount of sockets.
+     * \param timeout The amount of time in milliseconds to wait, 0 to only check.
+     * \param readable Receives for each socket whether it is readable.
+     *
+     * \return true if at least one socket is readable, false if the timeout expired or an error occurred.
+     */
+    static bool waitForAnyReadable(PlatformSocket* const* sockets, std::size_t count, int timeout, bool* readable);
+    /**
+     * Enable or disable Nagle's algorithm.
+     *
+     * \param no_delay true to send small segments immediately, false to let the kernel coalesce them.
+     *
+     * \return true if successful, false if not.
+     */
+    bool setNoDelay(bool no_delay);
+    /**
+     * Set the size of the kernel send buffer.
+     *
+     * \param size The requested size in bytes. The kernel may round or clamp it.
+     *
+     * \return true if successful, false if not.
+     */
+    bool setSendBufferSize(int size);
+    /**
+     * Set the size of the kernel receive buffer.
+     *
+     * \param size The requested size in bytes. The kernel may round or clamp it.
+     *
+     * \return true if successful, false if not.
+     *
+     * \note To allow a large TCP window this needs to be set before connecting or listening.
+     */
+    bool setReceiveBufferSize(int size);
+    /**
+     * \return The size of the kernel send buffer in bytes, or -1 if an error occurred.
+     */
+    int getSendBufferSize();
+    /**
+     * \return The size of the kernel receive buffer in bytes, or -1 if an error occurred.
+     */
+    int getReceiveBufferSize();
+    /**
+     * Let blocking reads busy-poll the device queue before sleeping.
+     *
+     * Only supported on Linux, elsewhere this fails for anything but 0.
+     *
+     * \param microseconds How long to busy-poll, 0 to disable.
+     *
+     * \return true if successful, false if not.
+     */
+    bool setBusyPoll(int microseconds);
+    /**
+     * Hold back partial segments until uncorked, so a batch of writes leaves in full segments.
+     *
+     * Only supported on Linux, elsewhere this fails when trying to cork.
+     *
+     * \param corked true to hold back partial segments, false to send everything that is pending.
+     *
+     * \return true if successful, false if not.
+     */
+    bool setCorked(bool corked);
+    /**
+     * Get and clear the pending error of the socket, for example the result of a non-blocking connect.
+     *
+     * \return The platform error code, or 0 if there is no pending error.
+     */
+    int takePendingError();
+    /**
+     * Did the last failed call fail only because it would have blocked?
+     *
+     * This is the case when a non-blocking socket has no data, no buffer space or
+     * an unfinished connection attempt.
+     */
+    bool wouldBlock();
     /**
      * Return the last error code as reported by the underlying platform.
      */
     int getNativeErrorCode();
+    /**
+     * Return the descriptor of the underlying platform socket, or -1 if there is none.
+     */
+    int getNativeHandle() const;
+    /**
+     * Set whether writeBuffers() may use io_uring, which it does not by default.
+     *
+     * This only has an effect when libArcus was built with ENABLE_IO_URING. Even then,
+     * the regular socket calls are used when the kernel does not support io_uring.
+     */
+    void setUseIoUring(bool use);
+    /**
+     * \return true if writeBuffers() currently submits through io_uring.
+     */
+    bool isUsingIoUring() const;
 
 private:
+    // Should a write that failed be tried again?
+    bool canRetryWrite();
+    // Has the write deadline not passed yet? Also true when there is none.
+    bool beforeWriteDeadline() const;
+
     int _socket_id;
+
+    // The bytes of an integer that was only partially received by readUInt32().
+    uint32_t _partial_word;
+    std::size_t _partial_size;
+
+    bool _blocking;
+    // The write deadline in ticks of the steady clock, 0 if there is none.
+    std::atomic<std::chrono::steady_clock::rep> _write_deadline;
+
+    bool _use_io_uring;
+    // Created on first use, so sockets that never write vectors do not pay for a ring.
+    std::unique_ptr<IoUring> _io_uring;
 };
 } // namespace Private
 } // namespace Arcus
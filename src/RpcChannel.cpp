@@ -0,0 +1,278 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "Arcus/RpcChannel.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "Arcus/Socket.h"
+
+using namespace Arcus;
+
+class RpcChannel::Private
+{
+public:
+    Private() : socket(nullptr), attached(false), next_call_id(1), stopping(false)
+    {
+    }
+
+    using Deadlines = std::multimap<std::chrono::steady_clock::time_point, uint32_t>;
+
+    /**
+     * A call that is waiting for its reply.
+     */
+    struct PendingCall
+    {
+        std::promise<CallResult> promise;
+        // The entry in deadlines, or deadlines.end() if the call has no timeout.
+        Deadlines::iterator deadline;
+    };
+
+    // End a call, returns false if it already ended.
+    bool finish(uint32_t call_id, CallStatus status, const MessagePtr& reply);
+    // End all calls that are still waiting.
+    void finishAll(CallStatus status);
+    // Expire calls whose timeout passed, run by timer_thread.
+    void runTimer();
+
+    Socket* socket;
+    bool attached;
+
+    mutable std::mutex mutex;
+    std::condition_variable timer_condition;
+    std::unordered_map<uint32_t, PendingCall> pending_calls;
+    Deadlines deadlines;
+    uint32_t next_call_id;
+    // Started with the first call that has a timeout.
+    std::thread timer_thread;
+    bool stopping;
+
+    std::mutex handler_mutex;
+    RequestHandler request_handler;
+};
+
+bool RpcChannel::Private::finish(uint32_t call_id, CallStatus status, const MessagePtr& reply)
+{
+    std::promise<CallResult> promise;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto call = pending_calls.find(call_id);
+        if (call == pending_calls.end())
+        {
+            return false;
+        }
+
+        if (call->second.deadline != deadlines.end())
+        {
+            deadlines.erase(call->second.deadline);
+        }
+        promise = std::move(call->second.promise);
+        pending_calls.erase(call);
+    }
+
+    CallResult result;
+    result.status = status;
+    result.reply = reply;
+    promise.set_value(result);
+    return true;
+}
+
+void RpcChannel::Private::finishAll(CallStatus status)
+{
+    std::unordered_map<uint32_t, PendingCall> calls;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        calls.swap(pending_calls);
+        deadlines.clear();
+    }
+
+    for (auto& call : calls)
+    {
+        CallResult result;
+        result.status = status;
+        call.second.promise.set_value(result);
+    }
+}
+
+void RpcChannel::Private::runTimer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (! stopping)
+    {
+        if (deadlines.empty())
+        {
+            timer_condition.wait(lock);
+            continue;
+        }
+
+        const auto first = deadlines.begin()->first;
+        if (std::chrono::steady_clock::now() < first)
+        {
+            timer_condition.wait_until(lock, first);
+            continue;
+        }
+
+        const uint32_t call_id = deadlines.begin()->second;
+        lock.unlock();
+        finish(call_id, CallStatus::TimedOut, MessagePtr());
+        lock.lock();
+    }
+}
+
+RpcChannel::RpcChannel(Socket& socket) : d(new Private)
+{
+    d->socket = &socket;
+    d->attached = socket.attachRpcChannel(this);
+}
+
+RpcChannel::~RpcChannel()
+{
+    Socket* socket = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        socket = d->attached ? d->socket : nullptr;
+        d->stopping = true;
+    }
+
+    if (socket)
+    {
+        socket->detachRpcChannel(this);
+    }
+
+    d->timer_condition.notify_all();
+    if (d->timer_thread.joinable())
+    {
+        d->timer_thread.join();
+    }
+
+    d->finishAll(CallStatus::Cancelled);
+}
+
+bool RpcChannel::isAttached() const
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->attached;
+}
+
+RpcChannel::Call RpcChannel::call(MessagePtr request, std::chrono::milliseconds timeout)
+{
+    Call call;
+    std::promise<CallResult> promise;
+    call.result = promise.get_future();
+
+    Socket* socket = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        if (d->attached && request)
+        {
+            socket = d->socket;
+            call.id = d->next_call_id++;
+            if (d->next_call_id == 0)
+            {
+                // 0 is never used, so it can mean "no call".
+                d->next_call_id = 1;
+            }
+
+            Private::PendingCall& pending = d->pending_calls[call.id];
+            pending.promise = std::move(promise);
+            pending.deadline = d->deadlines.end();
+            if (timeout.count() > 0)
+            {
+                pending.deadline = d->deadlines.emplace(std::chrono::steady_clock::now() + timeout, call.id);
+                if (! d->timer_thread.joinable())
+                {
+                    d->timer_thread = std::thread(&Private::runTimer, d.get());
+                }
+                d->timer_condition.notify_all();
+            }
+        }
+    }
+
+    if (! socket)
+    {
+        promise.set_value(CallResult());
+        return call;
+    }
+
+    // The call is registered before the request is sent, so even the fastest reply finds it.
+    if (! socket->sendTaggedMessage(request, false, call.id))
+    {
+        d->finish(call.id, CallStatus::Failed, MessagePtr());
+    }
+    return call;
+}
+
+bool RpcChannel::cancel(uint32_t call_id)
+{
+    return d->finish(call_id, CallStatus::Cancelled, MessagePtr());
+}
+
+std::size_t RpcChannel::getPendingCallCount() const
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->pending_calls.size();
+}
+
+void RpcChannel::setRequestHandler(RequestHandler handler)
+{
+    std::lock_guard<std::mutex> lock(d->handler_mutex);
+    d->request_handler = handler;
+}
+
+bool RpcChannel::reply(uint32_t call_id, MessagePtr reply)
+{
+    Socket* socket = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        socket = d->attached ? d->socket : nullptr;
+    }
+
+    if (! socket)
+    {
+        return false;
+    }
+    return socket->sendTaggedMessage(reply, true, call_id);
+}
+
+void RpcChannel::messageReceived(bool is_reply, uint32_t call_id, const MessagePtr& message)
+{
+    if (is_reply)
+    {
+        // A reply to a call that already ended is ignored.
+        d->finish(call_id, CallStatus::Replied, message);
+        return;
+    }
+
+    RequestHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(d->handler_mutex);
+        handler = d->request_handler;
+    }
+
+    if (handler)
+    {
+        handler(call_id, message);
+    }
+}
+
+void RpcChannel::stateChanged(SocketState state)
+{
+    if (state == SocketState::Closed || state == SocketState::Error)
+    {
+        d->finishAll(CallStatus::Failed);
+    }
+}
+
+void RpcChannel::forgetSocket()
+{
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->socket = nullptr;
+        d->attached = false;
+    }
+    d->finishAll(CallStatus::Failed);
+}
@@ -14,6 +14,17 @@ Socket::Socket() : d(new Private)
 
 Socket::~Socket()
 {
+    // Make sure no selector keeps a reference to this socket once it is gone.
+    std::list<SocketSelector*> selectors;
+    {
+        std::lock_guard<std::mutex> lock(d->selectors_mutex);
+        selectors.swap(d->selectors);
+    }
+    for (SocketSelector* selector : selectors)
+    {
+        selector->forgetSocket(this);
+    }
+
     if (d->thread)
     {
         if (d->state != SocketState::Closed || d->state != SocketState::Error)
@@ -22,6 +33,10 @@ Socket::~Socket()
         }
         delete d->thread;
     }
+    else if (d->embedded && d->state != SocketState::Initial && d->state != SocketState::Closed && d->state != SocketState::Error)
+    {
+        close();
+    }
 
     for (SocketListener* listener : d->listeners)
     {
@@ -33,6 +48,18 @@ Socket::~Socket()
 
         delete listener;
     }
+
+    if (d->notifier.getNativeHandle() != -1)
+    {
+        d->notifier.close();
+    }
+
+    std::lock_guard<std::mutex> lock(d->rpc_channel_mutex);
+    if (d->rpc_channel)
+    {
+        d->rpc_channel->forgetSocket();
+        d->rpc_channel = nullptr;
+    }
 }
 
 SocketState Socket::getState() const
@@ -42,11 +69,13 @@ SocketState Socket::getState() const
 
 Error Socket::getLastError() const
 {
+    std::lock_guard<std::recursive_mutex> lock(d->error_mutex);
     return d->last_error;
 }
 
 void Socket::clearError()
 {
+    std::lock_guard<std::recursive_mutex> lock(d->error_mutex);
     d->last_error = Error();
 }
 
@@ -58,7 +87,8 @@ bool Socket::registerMessageType(const google::protobuf::Message* message_type)
         return false;
     }
 
-    return d->message_types.registerMessageType(message_type);
+    MessageTypeStore* store = d->registrationStore();
+    return store && store->registerMessageType(message_type);
 }
 
 bool Socket::registerAllMessageTypes(const std::string& file_name)
@@ -75,9 +105,67 @@ bool Socket::registerAllMessageTypes(const std::string& file_name)
         return false;
     }
 
-    if (! d->message_types.registerAllMessageTypes(file_name))
+    MessageTypeStore* store = d->registrationStore();
+    if (! store)
+    {
+        return false;
+    }
+
+    if (! store->registerAllMessageTypes(file_name))
+    {
+        d->error(ErrorCode::MessageRegistrationFailedError, store->getErrorMessages());
+        return false;
+    }
+
+    return true;
+}
+
+bool Socket::registerAllMessageTypesFromDescriptorSet(const std::string& file_name)
+{
+    if (file_name.empty())
+    {
+        d->error(ErrorCode::MessageRegistrationFailedError, "Empty file name");
+        return false;
+    }
+
+    if (d->state != SocketState::Initial)
+    {
+        d->error(ErrorCode::MessageRegistrationFailedError, "Socket is not in initial state");
+        return false;
+    }
+
+    MessageTypeStore* store = d->registrationStore();
+    if (! store)
+    {
+        return false;
+    }
+
+    if (! store->registerAllMessageTypesFromDescriptorSet(file_name))
+    {
+        d->error(ErrorCode::MessageRegistrationFailedError, store->getErrorMessages());
+        return false;
+    }
+
+    return true;
+}
+
+bool Socket::registerAllMessageTypesFromDescriptorSet(const char* data, std::size_t size)
+{
+    if (d->state != SocketState::Initial)
+    {
+        d->error(ErrorCode::MessageRegistrationFailedError, "Socket is not in initial state");
+        return false;
+    }
+
+    MessageTypeStore* store = d->registrationStore();
+    if (! store)
     {
-        d->error(ErrorCode::MessageRegistrationFailedError, d->message_types.getErrorMessages());
+        return false;
+    }
+
+    if (! store->registerAllMessageTypesFromDescriptorSet(data, size))
+    {
+        d->error(ErrorCode::MessageRegistrationFailedError, store->getErrorMessages());
         return false;
     }
 
@@ -86,7 +174,173 @@ bool Socket::registerAllMessageTypes(const std::string& file_name)
 
 void Socket::dumpMessageTypes()
 {
-    d->message_types.dumpMessageTypes();
+    d->message_types->dumpMessageTypes();
+}
+
+void Socket::setMessageTypeStore(std::shared_ptr<const MessageTypeStore> store)
+{
+    if (d->state != SocketState::Initial)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return;
+    }
+
+    if (store)
+    {
+        d->own_message_types.reset();
+        d->message_types = store;
+    }
+    else
+    {
+        d->own_message_types = std::make_shared<MessageTypeStore>();
+        d->message_types = d->own_message_types;
+    }
+}
+
+void Socket::setEmbedded(bool embedded)
+{
+    if (d->state != SocketState::Initial || d->thread != nullptr)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return;
+    }
+
+    if (embedded && d->stream_count > 1)
+    {
+        d->error(ErrorCode::InvalidStateError, "Embedded mode does not support multiple streams");
+        return;
+    }
+
+    if (embedded && d->session_resume)
+    {
+        d->error(ErrorCode::InvalidStateError, "Embedded mode does not support session resume");
+        return;
+    }
+
+    d->embedded = embedded;
+}
+
+bool Socket::isEmbedded() const
+{
+    return d->embedded;
+}
+
+void Socket::setStreamCount(unsigned count)
+{
+    if (d->state != SocketState::Initial || d->thread != nullptr)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return;
+    }
+
+    if (count < 1)
+    {
+        d->error(ErrorCode::InvalidStateError, "A socket needs at least one stream");
+        return;
+    }
+
+    if (count > 1 && d->embedded)
+    {
+        d->error(ErrorCode::InvalidStateError, "Embedded mode does not support multiple streams");
+        return;
+    }
+
+    if (count > 1 && d->session_resume)
+    {
+        d->error(ErrorCode::InvalidStateError, "Session resume does not support multiple streams");
+        return;
+    }
+
+    d->stream_count = count;
+}
+
+unsigned Socket::getStreamCount() const
+{
+    return d->stream_count;
+}
+
+void Socket::setOptions(const SocketOptions& options)
+{
+    if (d->state != SocketState::Initial || d->thread != nullptr)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return;
+    }
+
+    d->options = options;
+}
+
+SocketOptions Socket::getOptions() const
+{
+    return d->options;
+}
+
+void Socket::setSessionResume(bool enabled)
+{
+    if (d->state != SocketState::Initial || d->thread != nullptr)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return;
+    }
+
+    if (enabled && (d->embedded || d->stream_count > 1))
+    {
+        d->error(ErrorCode::InvalidStateError, "Session resume is not supported in embedded mode or with multiple streams");
+        return;
+    }
+
+    if (! enabled)
+    {
+        d->clearSession();
+    }
+    d->session_resume = enabled;
+}
+
+bool Socket::isSessionResumeEnabled() const
+{
+    return d->session_resume;
+}
+
+std::chrono::microseconds Socket::getSmoothedRoundTripTime() const
+{
+    return std::chrono::microseconds(d->smoothed_round_trip_time.load());
+}
+
+int Socket::getNativeHandle() const
+{
+    if (d->state == SocketState::Initial || d->state == SocketState::Closed || d->state == SocketState::Error)
+    {
+        return -1;
+    }
+
+    return d->platform_socket.getNativeHandle();
+}
+
+IoInterest Socket::getIoInterest() const
+{
+    return d->getIoInterest();
+}
+
+void Socket::process()
+{
+    if (! d->embedded)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in embedded mode");
+        return;
+    }
+
+    // Keep going while the state changes, so a single call gets as far as possible.
+    SocketState previous_state;
+    do
+    {
+        previous_state = d->state;
+        d->process();
+    } while (d->state != previous_state && d->state != SocketState::Closed && d->state != SocketState::Error);
+
+    if (d->state == SocketState::Closed || d->state == SocketState::Error)
+    {
+        d->message_received_condition_variable.notify_all();
+    }
 }
 
 void Socket::addListener(SocketListener* listener)
@@ -121,10 +375,29 @@ void Socket::connect(const std::string& address, uint16_t port)
         return;
     }
 
+    // Types can no longer change, so build the lookup tables used for every frame.
+    if (d->own_message_types)
+    {
+        d->own_message_types->freeze();
+    }
     d->address = address;
     d->port = port;
-    d->thread = new std::thread([&]() { d->run(); });
+    d->session_initiator = true;
     d->next_state = SocketState::Connecting;
+
+    if (d->embedded)
+    {
+        process();
+        return;
+    }
+
+    if (d->notifier.getNativeHandle() == -1)
+    {
+        // Without it the worker still works, it just notices new work less quickly.
+        d->notifier.createNotifier();
+    }
+
+    d->thread = new std::thread([&]() { d->run(); });
 }
 
 void Socket::reset()
@@ -141,8 +414,16 @@ void Socket::reset()
         d->thread = nullptr;
     }
 
+    // A partially received frame is worthless on a new connection.
+    d->current_message.reset();
+    if (d->session_finished)
+    {
+        d->clearSession();
+    }
+
     d->state = SocketState::Initial;
     d->next_state = SocketState::Initial;
+    d->received_close = false;
     clearError();
 }
 
@@ -154,10 +435,67 @@ void Socket::listen(const std::string& address, uint16_t port)
         return;
     }
 
+    if (d->own_message_types)
+    {
+        d->own_message_types->freeze();
+    }
     d->address = address;
     d->port = port;
-    d->thread = new std::thread([&]() { d->run(); });
+    d->session_initiator = false;
     d->next_state = SocketState::Opening;
+
+    if (d->embedded)
+    {
+        process();
+        return;
+    }
+
+    if (d->notifier.getNativeHandle() == -1)
+    {
+        // Without it the worker still works, it just notices new work less quickly.
+        d->notifier.createNotifier();
+    }
+
+    d->thread = new std::thread([&]() { d->run(); });
+}
+
+void Socket::connectInProcess(Socket* peer, bool copy_messages)
+{
+    if (! peer || peer == this)
+    {
+        d->error(ErrorCode::InvalidStateError, "Cannot connect to an invalid socket");
+        return;
+    }
+
+    if (d->state != SocketState::Initial || d->thread != nullptr || peer->d->state != SocketState::Initial || peer->d->thread != nullptr)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return;
+    }
+
+    if (d->embedded || peer->d->embedded)
+    {
+        d->error(ErrorCode::InvalidStateError, "In-process connections are not supported in embedded mode");
+        return;
+    }
+
+    if (d->session_resume || peer->d->session_resume)
+    {
+        d->error(ErrorCode::InvalidStateError, "In-process connections do not support session resume");
+        return;
+    }
+
+    auto channel = std::make_shared<Private::LocalChannel>();
+    channel->ends[0] = d.get();
+    channel->ends[1] = peer->d.get();
+    channel->copy_messages = copy_messages;
+
+    for (Socket* socket : { this, peer })
+    {
+        socket->d->local_channel = channel;
+        socket->d->next_state = SocketState::Connecting;
+        socket->d->thread = new std::thread([socket]() { socket->d->run(); });
+    }
 }
 
 void Socket::close()
@@ -171,21 +509,83 @@ void Socket::close()
     if (d->state == SocketState::Closed || d->state == SocketState::Error)
     {
         // Silently ignore this, as calling close on an already closed socket should be fine.
+        // The worker thread may have closed the socket by itself, so it still needs to be joined.
         d->state = SocketState::Closed;
+        if (d->thread && d->thread->get_id() != std::this_thread::get_id())
+        {
+            d->thread->join();
+            delete d->thread;
+            d->thread = nullptr;
+        }
         d->message_received_condition_variable.notify_all();
         return;
     }
 
+    std::future<bool> closed = closeAsync(std::chrono::milliseconds(d->options.close_timeout));
+
+    // The worker thread cannot wait for itself, for example when closing from a listener callback.
+    const bool on_worker_thread = d->thread && d->thread->get_id() == std::this_thread::get_id();
+    if (! on_worker_thread)
+    {
+        closed.wait();
+    }
+
+    if (d->thread && ! on_worker_thread)
+    {
+        d->thread->join();
+        delete d->thread;
+        d->thread = nullptr;
+    }
+
+    // Notify all in case of closing because the waiting threads need to know
+    // that this socket has been closed and they should not wait any more.
+    d->message_received_condition_variable.notify_all();
+}
+
+std::future<bool> Socket::closeAsync(std::chrono::milliseconds flush_timeout)
+{
+    std::promise<bool> promise;
+    std::future<bool> closed = promise.get_future();
+
+    if (d->state == SocketState::Initial)
+    {
+        d->error(ErrorCode::InvalidStateError, "Cannot close a socket in initial state");
+        promise.set_value(false);
+        return closed;
+    }
+
+    {
+        // The worker fulfills the promises under this lock once the state is final, so checking here cannot miss it.
+        std::lock_guard<std::mutex> lock(d->close_mutex);
+        if (d->state == SocketState::Closed || d->state == SocketState::Error)
+        {
+            promise.set_value(d->state == SocketState::Closed && d->close_flushed);
+            return closed;
+        }
+        d->close_promises.push_back(std::move(promise));
+    }
+
+    if (d->state == SocketState::Closing)
+    {
+        // Already on its way, the promise is fulfilled together with the others.
+        return closed;
+    }
+
     if (d->state == SocketState::Connected)
     {
-        // Make the socket request close.
-        d->next_state = SocketState::Closing;
+        // Closing on purpose ends the session, there is nothing left to resume.
+        d->session_finished = true;
 
-        // Wait with closing until we properly clear the send queue.
-        while (d->state == SocketState::Closing)
+        // Make the socket request close.
+        // The write deadline also ends writes the worker is blocked in right now.
+        d->close_deadline = std::chrono::steady_clock::now() + flush_timeout;
+        for (std::size_t i = 0; i < d->extra_streams.size() + 1; ++i)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            d->streamSocket(i).setWriteDeadline(d->close_deadline);
         }
+        d->next_state = SocketState::Closing;
+        d->local_condition.notify_all();
+        d->wakeWorker();
     }
     else
     {
@@ -197,16 +597,16 @@ void Socket::close()
         d->next_state = SocketState::Closed;
     }
 
-    if (d->thread)
+    if (d->embedded)
     {
-        d->thread->join();
-        delete d->thread;
-        d->thread = nullptr;
+        // There is no thread to do it for us, so perform the close handshake right here.
+        while (d->state != SocketState::Closed && d->state != SocketState::Error)
+        {
+            d->process();
+        }
     }
 
-    // Notify all in case of closing because the waiting threads need to know
-    // that this socket has been closed and they should not wait any more.
-    d->message_received_condition_variable.notify_all();
+    return closed;
 }
 
 bool Socket::sendMessage(MessagePtr message)
@@ -223,24 +623,47 @@ bool Socket::sendMessage(MessagePtr message)
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(d->sendQueueMutex);
-    d->sendQueue.push_back(message);
+    d->queueMessage(message, nullptr);
     return true;
 }
 
+std::future<SendReceipt> Socket::sendMessage(MessagePtr message, SendCompletion completion)
+{
+    auto tracker = std::make_shared<Private::SendTracker>();
+    tracker->completion = completion;
+    tracker->receipt.queued_time = std::chrono::steady_clock::now();
+    std::future<SendReceipt> receipt = tracker->promise.get_future();
+
+    if (! message)
+    {
+        d->error(ErrorCode::InvalidMessageError, "Message cannot be nullptr");
+        tracker->promise.set_value(tracker->receipt);
+        return receipt;
+    }
+
+    if (message->ByteSizeLong() > Private::message_size_maximum)
+    {
+        d->error(ErrorCode::MessageTooBigError, "Message is too big to be sent");
+        tracker->promise.set_value(tracker->receipt);
+        return receipt;
+    }
+
+    if (! d->queueMessage(message, tracker))
+    {
+        // Nothing will pick up the queue until the socket is reset, so there is nothing to wait for.
+        tracker->promise.set_value(tracker->receipt);
+    }
+    return receipt;
+}
+
 MessagePtr Socket::takeNextMessage()
 {
     std::unique_lock<std::mutex> lk(d->receiveQueueMutexBlock);
 
     // Take the next message in the receive queue if available.
+    if (MessagePtr next = d->takeReceivedMessage())
     {
-        std::lock_guard<std::mutex> lock(d->receiveQueueMutex);
-        if (d->receiveQueue.size() > 0)
-        {
-            MessagePtr next = d->receiveQueue.front();
-            d->receiveQueue.pop_front();
-            return next;
-        }
+        return next;
     }
 
     // For a blocking call, wait until the receive queue available signal gets triggered and fetch the first message
@@ -262,7 +685,224 @@ MessagePtr Socket::takeNextMessage()
     return result;
 }
 
+MessagePtr Socket::tryTakeNextMessage()
+{
+    return d->takeReceivedMessage();
+}
+
+void Socket::addSelector(SocketSelector* selector)
+{
+    std::lock_guard<std::mutex> lock(d->selectors_mutex);
+    d->selectors.push_back(selector);
+}
+
+void Socket::removeSelector(SocketSelector* selector)
+{
+    std::lock_guard<std::mutex> lock(d->selectors_mutex);
+    d->selectors.remove(selector);
+}
+
+uint32_t Socket::getEventSerial() const
+{
+    return d->event_serial;
+}
+
+bool Socket::hasPendingMessages() const
+{
+    return d->hasPendingMessages();
+}
+
+SocketStatistics Socket::getStatistics() const
+{
+    return d->statistics.snapshot();
+}
+
+void Socket::setStatisticsInterval(std::chrono::milliseconds interval)
+{
+    d->statistics_interval = interval;
+}
+
+void Socket::setTracing(std::size_t capacity)
+{
+    // The worker and reader threads use the tracer without locking, so it can only change once they are gone.
+    if (d->state != SocketState::Initial || d->thread != nullptr)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return;
+    }
+
+    if (capacity == 0)
+    {
+        d->tracer.reset();
+    }
+    else
+    {
+        d->tracer = std::make_unique<Arcus::Private::MessageTracer>(capacity);
+    }
+}
+
+bool Socket::setCapture(const std::string& file_name)
+{
+    // The worker and reader threads use the capture without locking, so it can only change once they are gone.
+    if (d->state != SocketState::Initial || d->thread != nullptr)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not in initial state");
+        return false;
+    }
+
+    d->capture.reset();
+    if (file_name.empty())
+    {
+        return true;
+    }
+
+    auto capture = std::make_unique<Arcus::Private::CaptureWriter>();
+    if (! capture->open(file_name))
+    {
+        d->error(ErrorCode::CreationError, "Could not create capture file " + file_name);
+        return false;
+    }
+    d->capture = std::move(capture);
+    return true;
+}
+
+bool Socket::writeTrace(std::ostream& stream) const
+{
+    if (! d->tracer)
+    {
+        return false;
+    }
+
+    d->tracer->write(stream);
+    return true;
+}
+
+ReceiveAwaitable Socket::receive()
+{
+    return ReceiveAwaitable(*this);
+}
+
+SendAwaitable Socket::send(MessagePtr message)
+{
+    return SendAwaitable(*this, message);
+}
+
+bool Socket::takeOrWaitForMessage(ReceiveAwaitable* waiter)
+{
+    std::unique_lock<std::mutex> lock(d->receiveQueueMutex);
+    Private::ReceivedMessage next;
+    while (d->popReceivedMessage(next))
+    {
+        // Messages whose parsing was deferred are parsed outside of the lock, and skipped if that fails.
+        lock.unlock();
+        waiter->_message = d->completeReceivedMessage(next);
+        if (waiter->_message)
+        {
+            return false;
+        }
+        lock.lock();
+    }
+
+    if (d->state == SocketState::Closed || d->state == SocketState::Error)
+    {
+        return false;
+    }
+
+    d->receive_waiters.push_back(waiter);
+    return true;
+}
+
+bool Socket::sendAndWait(SendAwaitable* waiter)
+{
+    waiter->_receipt.queued_time = std::chrono::steady_clock::now();
+    if (! waiter->_message)
+    {
+        d->error(ErrorCode::InvalidMessageError, "Message cannot be nullptr");
+        return false;
+    }
+
+    if (waiter->_message->ByteSizeLong() > Private::message_size_maximum)
+    {
+        d->error(ErrorCode::MessageTooBigError, "Message is too big to be sent");
+        return false;
+    }
+
+    auto tracker = std::make_shared<Private::SendTracker>();
+    tracker->receipt = waiter->_receipt;
+    tracker->awaiter = waiter;
+    // The coroutine may be resumed on the worker thread before this returns, so the waiter is not touched after this.
+    // If the socket already stopped, nothing will resume it, so it continues right away.
+    return d->queueMessage(waiter->_message, tracker);
+}
+
+bool ReceiveAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    _handle = handle;
+    return _socket->takeOrWaitForMessage(this);
+}
+
+MessagePtr ReceiveAwaitable::await_resume()
+{
+    return std::move(_message);
+}
+
+bool SendAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    _handle = handle;
+    return _socket->sendAndWait(this);
+}
+
+bool Socket::attachRpcChannel(RpcChannel* channel)
+{
+    std::lock_guard<std::mutex> lock(d->rpc_channel_mutex);
+    if (d->rpc_channel)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket already has an RPC channel");
+        return false;
+    }
+
+    d->rpc_channel = channel;
+    return true;
+}
+
+void Socket::detachRpcChannel(RpcChannel* channel)
+{
+    // Waits for a message that is being handed to the channel.
+    std::lock_guard<std::mutex> lock(d->rpc_channel_mutex);
+    if (d->rpc_channel == channel)
+    {
+        d->rpc_channel = nullptr;
+    }
+}
+
+bool Socket::sendTaggedMessage(MessagePtr message, bool is_reply, uint32_t call_id)
+{
+    if (! message)
+    {
+        d->error(ErrorCode::InvalidMessageError, "Message cannot be nullptr");
+        return false;
+    }
+
+    if (message->ByteSizeLong() > Private::message_size_maximum)
+    {
+        d->error(ErrorCode::MessageTooBigError, "Message is too big to be sent");
+        return false;
+    }
+
+    if (d->state == SocketState::Closed || d->state == SocketState::Error)
+    {
+        d->error(ErrorCode::InvalidStateError, "Socket is not connected");
+        return false;
+    }
+
+    Private::Correlation correlation;
+    correlation.control = is_reply ? SOCKET_REPLY : SOCKET_REQUEST;
+    correlation.call_id = call_id;
+    d->queueMessage(message, nullptr, correlation);
+    return true;
+}
+
 MessagePtr Arcus::Socket::createMessage(const std::string& type)
 {
-    return d->message_types.createMessage(type);
+    return d->message_types->createMessage(type);
 }
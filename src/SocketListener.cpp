@@ -12,6 +12,10 @@ Socket* SocketListener::getSocket() const
     return _socket;
 }
 
+void SocketListener::statisticsUpdated(const SocketStatistics& /*statistics*/)
+{
+}
+
 void SocketListener::setSocket(Socket* socket)
 {
     _socket = socket;
@@ -0,0 +1,33 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "Arcus/SocketOptions.h"
+
+using namespace Arcus;
+
+SocketOptions SocketOptions::defaults()
+{
+    return SocketOptions();
+}
+
+SocketOptions SocketOptions::lowLatency()
+{
+    SocketOptions options;
+    options.no_delay = true;
+    options.send_buffer_size = 64 * 1024;
+    options.receive_buffer_size = 64 * 1024;
+    options.busy_poll = 50;
+    return options;
+}
+
+SocketOptions SocketOptions::bulkThroughput()
+{
+    SocketOptions options;
+    options.no_delay = true;
+    options.send_buffer_size = 1024 * 1024;
+    options.receive_buffer_size = 1024 * 1024;
+    options.cork = true;
+    options.adaptive_buffers = true;
+    options.max_buffer_size = 16 * 1024 * 1024;
+    return options;
+}
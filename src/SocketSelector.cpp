@@ -0,0 +1,162 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "Arcus/SocketSelector.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
+#include "Arcus/Socket.h"
+
+using namespace Arcus;
+
+class SocketSelector::Private
+{
+public:
+    Private() : generation(0), interrupted(false)
+    {
+    }
+
+    // Collect the sockets that had events since they were last returned or have pending messages.
+    std::vector<Socket*> collectReady();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // The registered sockets, mapped to the event serial they had when they were last reported.
+    std::unordered_map<Socket*, uint32_t> sockets;
+
+    // Incremented whenever one of the sockets wakes us up.
+    uint64_t generation;
+    bool interrupted;
+};
+
+std::vector<Socket*> SocketSelector::Private::collectReady()
+{
+    std::vector<Socket*> ready;
+    for (auto& entry : sockets)
+    {
+        const uint32_t serial = entry.first->getEventSerial();
+        if (serial != entry.second || entry.first->hasPendingMessages())
+        {
+            entry.second = serial;
+            ready.push_back(entry.first);
+        }
+    }
+    return ready;
+}
+
+SocketSelector::SocketSelector() : d(new Private)
+{
+}
+
+SocketSelector::~SocketSelector()
+{
+    std::unordered_map<Socket*, uint32_t> sockets;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        sockets.swap(d->sockets);
+    }
+
+    for (auto& entry : sockets)
+    {
+        entry.first->removeSelector(this);
+    }
+}
+
+bool SocketSelector::addSocket(Socket* socket)
+{
+    if (! socket)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        if (d->sockets.find(socket) != d->sockets.end())
+        {
+            return false;
+        }
+
+        d->sockets[socket] = socket->getEventSerial();
+    }
+
+    // Do not hold our own lock here, the socket takes its lock before calling wakeUp().
+    socket->addSelector(this);
+    return true;
+}
+
+bool SocketSelector::removeSocket(Socket* socket)
+{
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        if (d->sockets.erase(socket) == 0)
+        {
+            return false;
+        }
+    }
+
+    socket->removeSelector(this);
+    return true;
+}
+
+std::vector<Socket*> SocketSelector::wait()
+{
+    std::unique_lock<std::mutex> lock(d->mutex);
+
+    while (true)
+    {
+        auto ready = d->collectReady();
+        if (! ready.empty() || d->interrupted)
+        {
+            d->interrupted = false;
+            return ready;
+        }
+
+        const uint64_t generation = d->generation;
+        d->condition.wait(lock, [&]() { return d->generation != generation || d->interrupted; });
+    }
+}
+
+std::vector<Socket*> SocketSelector::waitFor(std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock<std::mutex> lock(d->mutex);
+
+    while (true)
+    {
+        auto ready = d->collectReady();
+        if (! ready.empty() || d->interrupted)
+        {
+            d->interrupted = false;
+            return ready;
+        }
+
+        const uint64_t generation = d->generation;
+        if (! d->condition.wait_until(lock, deadline, [&]() { return d->generation != generation || d->interrupted; }))
+        {
+            return ready;
+        }
+    }
+}
+
+void SocketSelector::interrupt()
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->interrupted = true;
+    d->condition.notify_all();
+}
+
+void SocketSelector::wakeUp()
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    ++d->generation;
+    d->condition.notify_all();
+}
+
+void SocketSelector::forgetSocket(Socket* socket)
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->sockets.erase(socket);
+}
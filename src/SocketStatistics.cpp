@@ -0,0 +1,262 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "Arcus/SocketStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "SocketStatistics_p.h"
+
+using namespace Arcus;
+using namespace Arcus::Private;
+
+namespace
+{
+constexpr auto relaxed = std::memory_order_relaxed;
+
+// Raise a maximum that other threads may raise at the same time.
+template<typename T>
+void raiseTo(std::atomic<T>& maximum, T value)
+{
+    T current = maximum.load(relaxed);
+    while (current < value && ! maximum.compare_exchange_weak(current, value, relaxed))
+    {
+    }
+}
+} // namespace
+
+std::chrono::microseconds DurationHistogram::mean() const
+{
+    if (count == 0)
+    {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds(total.count() / static_cast<std::chrono::microseconds::rep>(count));
+}
+
+std::chrono::microseconds DurationHistogram::percentile(double percentile) const
+{
+    if (count == 0)
+    {
+        return std::chrono::microseconds(0);
+    }
+
+    const double rank = std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(count);
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(rank)));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+        {
+            const std::chrono::microseconds upper_bound(static_cast<std::chrono::microseconds::rep>(1) << i);
+            return std::min(upper_bound, maximum);
+        }
+    }
+    return maximum;
+}
+
+DurationRecorder::DurationRecorder() : count(0), total(0), maximum(0)
+{
+    for (auto& bucket : buckets)
+    {
+        bucket.store(0, relaxed);
+    }
+}
+
+void DurationRecorder::record(std::chrono::steady_clock::duration duration)
+{
+    const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    const uint64_t value = microseconds > 0 ? static_cast<uint64_t>(microseconds) : 0;
+
+    // The bucket is the amount of bits needed for the value, 0 for anything below a microsecond.
+    std::size_t bucket = 0;
+    for (uint64_t remaining = value; remaining != 0 && bucket < DurationHistogram::BUCKET_COUNT - 1; remaining >>= 1)
+    {
+        ++bucket;
+    }
+
+    buckets[bucket].fetch_add(1, relaxed);
+    count.fetch_add(1, relaxed);
+    total.fetch_add(value, relaxed);
+    raiseTo(maximum, value);
+}
+
+DurationHistogram DurationRecorder::snapshot() const
+{
+    DurationHistogram histogram;
+    for (std::size_t i = 0; i < DurationHistogram::BUCKET_COUNT; ++i)
+    {
+        histogram.buckets[i] = buckets[i].load(relaxed);
+    }
+    histogram.count = count.load(relaxed);
+    histogram.total = std::chrono::microseconds(total.load(relaxed));
+    histogram.maximum = std::chrono::microseconds(maximum.load(relaxed));
+    return histogram;
+}
+
+StatisticsCollector::StatisticsCollector()
+    : send_queue_depth(0)
+    , send_queue_peak(0)
+    , receive_queue_depth(0)
+    , receive_queue_peak(0)
+    , send_queue_bytes(0)
+    , send_queue_bytes_peak(0)
+    , receive_queue_bytes(0)
+    , receive_queue_bytes_peak(0)
+    , receive_queue_spilled_bytes(0)
+    , messages_deferred(0)
+    , messages_spilled(0)
+    , receive_pauses(0)
+    , keep_alives_sent(0)
+    , keep_alives_received(0)
+    , errors(0)
+    , fatal_errors(0)
+{
+}
+
+StatisticsCollector::TypeCounters& StatisticsCollector::countersFor(uint32_t type_id)
+{
+    if (type_id == 0)
+    {
+        return overflow;
+    }
+
+    // Type IDs are hashes already, so their low bits spread well enough.
+    for (std::size_t probe = 0; probe < TYPE_SLOTS; ++probe)
+    {
+        TypeCounters& slot = types[(type_id + probe) % TYPE_SLOTS];
+        uint32_t current = slot.type_id.load(relaxed);
+        if (current == 0 && slot.type_id.compare_exchange_strong(current, type_id, relaxed))
+        {
+            return slot;
+        }
+        if (current == type_id)
+        {
+            return slot;
+        }
+    }
+    return overflow;
+}
+
+void StatisticsCollector::messageSent(uint32_t type_id, std::size_t bytes)
+{
+    TypeCounters& counters = countersFor(type_id);
+    counters.messages_sent.fetch_add(1, relaxed);
+    counters.bytes_sent.fetch_add(bytes, relaxed);
+}
+
+void StatisticsCollector::messageReceived(uint32_t type_id, std::size_t bytes)
+{
+    TypeCounters& counters = countersFor(type_id);
+    counters.messages_received.fetch_add(1, relaxed);
+    counters.bytes_received.fetch_add(bytes, relaxed);
+}
+
+void StatisticsCollector::sendQueueDepth(std::size_t depth, std::size_t bytes)
+{
+    send_queue_depth.store(depth, relaxed);
+    raiseTo(send_queue_peak, depth);
+    send_queue_bytes.store(bytes, relaxed);
+    raiseTo(send_queue_bytes_peak, bytes);
+}
+
+void StatisticsCollector::receiveQueueDepth(std::size_t depth, std::size_t bytes, std::size_t spilled_bytes)
+{
+    receive_queue_depth.store(depth, relaxed);
+    raiseTo(receive_queue_peak, depth);
+    receive_queue_bytes.store(bytes, relaxed);
+    raiseTo(receive_queue_bytes_peak, bytes);
+    receive_queue_spilled_bytes.store(spilled_bytes, relaxed);
+}
+
+void StatisticsCollector::messageDeferred(bool spilled)
+{
+    messages_deferred.fetch_add(1, relaxed);
+    if (spilled)
+    {
+        messages_spilled.fetch_add(1, relaxed);
+    }
+}
+
+void StatisticsCollector::receivePaused()
+{
+    receive_pauses.fetch_add(1, relaxed);
+}
+
+void StatisticsCollector::keepAliveSent()
+{
+    keep_alives_sent.fetch_add(1, relaxed);
+}
+
+void StatisticsCollector::keepAliveReceived()
+{
+    keep_alives_received.fetch_add(1, relaxed);
+}
+
+void StatisticsCollector::errorReported(bool fatal)
+{
+    errors.fetch_add(1, relaxed);
+    if (fatal)
+    {
+        fatal_errors.fetch_add(1, relaxed);
+    }
+}
+
+SocketStatistics StatisticsCollector::snapshot() const
+{
+    SocketStatistics statistics;
+    statistics.time = std::chrono::steady_clock::now();
+
+    auto add = [&statistics](uint32_t type_id, const TypeCounters& counters)
+    {
+        MessageTypeStatistics type;
+        type.messages_sent = counters.messages_sent.load(relaxed);
+        type.bytes_sent = counters.bytes_sent.load(relaxed);
+        type.messages_received = counters.messages_received.load(relaxed);
+        type.bytes_received = counters.bytes_received.load(relaxed);
+        if (type.messages_sent == 0 && type.messages_received == 0)
+        {
+            return;
+        }
+
+        statistics.messages_sent += type.messages_sent;
+        statistics.bytes_sent += type.bytes_sent;
+        statistics.messages_received += type.messages_received;
+        statistics.bytes_received += type.bytes_received;
+        statistics.message_types[type_id] = type;
+    };
+    for (const auto& slot : types)
+    {
+        const uint32_t type_id = slot.type_id.load(relaxed);
+        if (type_id != 0)
+        {
+            add(type_id, slot);
+        }
+    }
+    add(0, overflow);
+
+    statistics.send_queue_depth = send_queue_depth.load(relaxed);
+    statistics.send_queue_peak = send_queue_peak.load(relaxed);
+    statistics.receive_queue_depth = receive_queue_depth.load(relaxed);
+    statistics.receive_queue_peak = receive_queue_peak.load(relaxed);
+    statistics.send_queue_bytes = send_queue_bytes.load(relaxed);
+    statistics.send_queue_bytes_peak = send_queue_bytes_peak.load(relaxed);
+    statistics.receive_queue_bytes = receive_queue_bytes.load(relaxed);
+    statistics.receive_queue_bytes_peak = receive_queue_bytes_peak.load(relaxed);
+    statistics.receive_queue_spilled_bytes = receive_queue_spilled_bytes.load(relaxed);
+    statistics.messages_deferred = messages_deferred.load(relaxed);
+    statistics.messages_spilled = messages_spilled.load(relaxed);
+    statistics.receive_pauses = receive_pauses.load(relaxed);
+
+    statistics.parse_time = parse_time.snapshot();
+    statistics.send_queue_time = send_queue_time.snapshot();
+    statistics.receive_queue_time = receive_queue_time.snapshot();
+
+    statistics.keep_alives_sent = keep_alives_sent.load(relaxed);
+    statistics.keep_alives_received = keep_alives_received.load(relaxed);
+    statistics.errors = errors.load(relaxed);
+    statistics.fatal_errors = fatal_errors.load(relaxed);
+    return statistics;
+}
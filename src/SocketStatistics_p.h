@@ -0,0 +1,107 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_SOCKET_STATISTICS_P_H
+#define ARCUS_SOCKET_STATISTICS_P_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "Arcus/SocketStatistics.h"
+
+namespace Arcus
+{
+namespace Private
+{
+/**
+ * Records durations into a DurationHistogram from any thread without locking.
+ */
+class DurationRecorder
+{
+public:
+    DurationRecorder();
+
+    void record(std::chrono::steady_clock::duration duration);
+    DurationHistogram snapshot() const;
+
+private:
+    std::array<std::atomic<uint64_t>, DurationHistogram::BUCKET_COUNT> buckets;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total; // In microseconds.
+    std::atomic<uint64_t> maximum; // In microseconds.
+};
+
+/**
+ * The counters behind Socket::getStatistics().
+ *
+ * Everything is updated with relaxed atomics, since this is done for every message
+ * and nothing else is ordered by it. Per type counters live in a fixed table that
+ * slots are claimed in as types are first seen, so they never need a lock either.
+ */
+class StatisticsCollector
+{
+public:
+    static constexpr std::size_t TYPE_SLOTS = 256;
+
+    StatisticsCollector();
+
+    void messageSent(uint32_t type_id, std::size_t bytes);
+    void messageReceived(uint32_t type_id, std::size_t bytes);
+    void sendQueueDepth(std::size_t depth, std::size_t bytes);
+    void receiveQueueDepth(std::size_t depth, std::size_t bytes, std::size_t spilled_bytes);
+    void messageDeferred(bool spilled);
+    void receivePaused();
+    void keepAliveSent();
+    void keepAliveReceived();
+    void errorReported(bool fatal);
+
+    SocketStatistics snapshot() const;
+
+    DurationRecorder parse_time;
+    DurationRecorder send_queue_time;
+    DurationRecorder receive_queue_time;
+
+private:
+    struct TypeCounters
+    {
+        TypeCounters() : type_id(0), messages_sent(0), bytes_sent(0), messages_received(0), bytes_received(0)
+        {
+        }
+
+        std::atomic<uint32_t> type_id; // 0 while the slot is free.
+        std::atomic<uint64_t> messages_sent;
+        std::atomic<uint64_t> bytes_sent;
+        std::atomic<uint64_t> messages_received;
+        std::atomic<uint64_t> bytes_received;
+    };
+
+    // Find or claim the slot of a type, or the overflow slot if the table is full.
+    TypeCounters& countersFor(uint32_t type_id);
+
+    std::array<TypeCounters, TYPE_SLOTS> types;
+    TypeCounters overflow;
+
+    std::atomic<std::size_t> send_queue_depth;
+    std::atomic<std::size_t> send_queue_peak;
+    std::atomic<std::size_t> receive_queue_depth;
+    std::atomic<std::size_t> receive_queue_peak;
+    std::atomic<std::size_t> send_queue_bytes;
+    std::atomic<std::size_t> send_queue_bytes_peak;
+    std::atomic<std::size_t> receive_queue_bytes;
+    std::atomic<std::size_t> receive_queue_bytes_peak;
+    std::atomic<std::size_t> receive_queue_spilled_bytes;
+    std::atomic<uint64_t> messages_deferred;
+    std::atomic<uint64_t> messages_spilled;
+    std::atomic<uint64_t> receive_pauses;
+    std::atomic<uint64_t> keep_alives_sent;
+    std::atomic<uint64_t> keep_alives_received;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> fatal_errors;
+};
+} // namespace Private
+} // namespace Arcus
+
+#endif // ARCUS_SOCKET_STATISTICS_P_H
@@ -4,15 +4,22 @@
 #ifndef SOCKET_P_H
 #define SOCKET_P_H
 
+#include <algorithm>
+#include <atomic>
+#include <array>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <future>
 #include <mutex>
+#include <random>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -33,11 +40,18 @@
 
 #include "Arcus/Error.h"
 #include "Arcus/MessageTypeStore.h"
+#include "Arcus/RpcChannel.h"
 #include "Arcus/Socket.h"
 #include "Arcus/SocketListener.h"
+#include "Arcus/SocketOptions.h"
+#include "Arcus/SocketSelector.h"
 #include "Arcus/Types.h"
 
+#include "CaptureFile_p.h"
+#include "MessageTracer_p.h"
 #include "PlatformSocket_p.h"
+#include "SocketStatistics_p.h"
+#include "SpillFile_p.h"
 #include "WireMessage_p.h"
 
 #define VERSION_MAJOR 1
@@ -47,6 +61,22 @@
 #define SIG(n) (((n) & 0xffff0000) >> 16)
 
 #define SOCKET_CLOSE 0xf0f0f0f0
+// Precedes a frame sent over one of several streams, followed by the sequence number of that frame.
+#define SOCKET_SEQUENCE 0xf0f0f0e1
+// Starts a reliable session on a new connection, followed by the session id.
+#define SOCKET_SESSION 0xf0f0f0e2
+// Acknowledges frames of a reliable session, followed by the amount of frames received so far.
+#define SOCKET_ACK 0xf0f0f0e3
+// Asks the other side to echo the following token, to measure the round trip time.
+#define SOCKET_PING 0xf0f0f0e4
+// The answer to SOCKET_PING, followed by the token of the ping.
+#define SOCKET_PONG 0xf0f0f0e5
+// Tags the next frame as a request made through an RpcChannel, followed by the call id.
+#define SOCKET_REQUEST 0xf0f0f0e6
+// Tags the next frame as the reply to a request, followed by the call id of the request.
+#define SOCKET_REPLY 0xf0f0f0e7
+// The amount of received frames after which an acknowledgement is sent without waiting for the keep-alive.
+#define SESSION_ACK_INTERVAL 64
 
 #ifdef ARCUS_DEBUG
 #define DEBUG(message) debug(message)
@@ -64,15 +94,147 @@ using namespace Private;
 class Socket::Private
 {
 public:
-    Private() : state(SocketState::Initial), next_state(SocketState::Initial), received_close(false), port(0), thread(nullptr)
+    /**
+     * The connection between two sockets in the same process.
+     *
+     * Messages are handed over as MessagePtr, without serializing them.
+     */
+    struct LocalChannel
+    {
+        std::mutex mutex;
+        // The two ends of the connection, reset to nullptr when an end closes.
+        Private* ends[2];
+        // Should the receiving end get a deep copy instead of the sender's instance?
+        bool copy_messages;
+    };
+
+    /**
+     * The tag of a frame sent through an RpcChannel.
+     */
+    struct Correlation
+    {
+        Correlation() : control(0), call_id(0)
+        {
+        }
+
+        // SOCKET_REQUEST or SOCKET_REPLY, or 0 for a frame without a tag.
+        uint32_t control;
+        uint32_t call_id;
+    };
+
+    /**
+     * Keeps track of a message sent with Socket::sendMessage(MessagePtr, SendCompletion).
+     */
+    struct SendTracker
+    {
+        std::promise<SendReceipt> promise;
+        SendReceipt receipt;
+        SendCompletion completion = SendCompletion::Written;
+        // The coroutine to resume instead of fulfilling the promise, for Socket::send().
+        SendAwaitable* awaiter = nullptr;
+    };
+
+    /**
+     * When a message entered the send queue, its serialized size and what else was queued with it.
+     */
+    struct QueueEntry
+    {
+        std::chrono::steady_clock::time_point time;
+        std::size_t size;
+        // Set when this frame of the message is tracked. The same message may be queued more than once.
+        std::shared_ptr<SendTracker> tracker;
+        // The tag of this frame, if it was sent through an RpcChannel.
+        Correlation correlation;
+    };
+
+    /**
+     * A received message on its way to the application.
+     *
+     * When its parsing is deferred, the message is still empty and its serialized form
+     * is either held in data or written to the spill file at spill_offset.
+     */
+    struct ReceivedMessage
+    {
+        ReceivedMessage(MessagePtr received_message = MessagePtr(), uint32_t received_size = 0) : message(received_message), size(received_size), spill_offset(-1)
+        {
+        }
+
+        bool isParsed() const
+        {
+            return ! data && spill_offset < 0;
+        }
+
+        MessagePtr message;
+        // The serialized size, 0 for messages from a socket in the same process.
+        uint32_t size;
+        std::unique_ptr<char[]> data;
+        int64_t spill_offset;
+        // When it entered the receive queue.
+        std::chrono::steady_clock::time_point time;
+    };
+
+    Private() : state(SocketState::Initial), next_state(SocketState::Initial), received_close(false), port(0), thread(nullptr), embedded(false), connect_pending(false), send_buffer_offset(0), kernel_send_buffer_size(0), kernel_receive_buffer_size(0), own_message_types(std::make_shared<MessageTypeStore>()), message_types(own_message_types), stream_count(1), next_send_sequence(0), next_receive_sequence(0), close_requests_received(0), session_resume(false), session_initiator(false), session_id(0), peer_session_id(0), session_established(false), session_finished(false), frames_sent(0), frames_received(0), frames_acknowledged(0), send_queue_bytes(0), rpc_channel(nullptr), receive_queue_length(0), receive_queue_bytes(0), receive_queue_spilled_bytes(0), spill_failed(false), event_serial(0), receive_paused(false), pong_pending(false), pong_token(0), reader_out_of_memory(false), ping_outstanding(false), ping_token(0), smoothed_round_trip_time(0), close_flushed(true), statistics_interval(std::chrono::milliseconds(0))
     {
     }
 
     void run();
-    void sendMessage(const MessagePtr& message);
-    void receiveNextMessage();
+    void process();
+    void updateState();
+    void limitCloseToDeadline();
+    bool sendMessages(const std::list<MessagePtr>& messages, const std::vector<Correlation>& frame_correlations = std::vector<Correlation>());
+
+    bool queueMessage(const MessagePtr& message, const std::shared_ptr<SendTracker>& tracker, const Correlation& correlation = Correlation());
+    void reportWritten(const std::vector<std::shared_ptr<SendTracker>>& frame_trackers, uint32_t first_frame, bool written);
+    void reportAcknowledged(uint32_t peer_received);
+    void failTrackedSends(bool keep_for_resume);
+    void completeSend(const std::shared_ptr<SendTracker>& tracker);
+    void resumeReceivers();
+    void appendMessage(const MessagePtr& message, const Correlation& correlation);
+    bool writeControl(uint32_t value);
+    bool writeControl(uint32_t value, uint32_t argument);
+    void recordRoundTrip(uint32_t token);
+    bool flushSendBuffer();
+    IoInterest getIoInterest();
+    bool createSocket(PlatformSocket& socket);
+    void applyOptions(PlatformSocket& socket);
+    void growBuffers(std::size_t frame_size, bool sending);
+    PlatformSocket& streamSocket(std::size_t index);
+    bool connectExtraStreams();
+    bool acceptExtraStreams();
+    void closeExtraStreams();
+    void receiveFromStreams();
+    void wakeWorker();
+    bool useDuplexThreads() const;
+    void startReader();
+    void stopReader();
+    void runReader();
+    void receiveNextMessage(PlatformSocket& stream_socket, std::shared_ptr<WireMessage>& message, bool on_reader_thread = false);
     void handleMessage(const std::shared_ptr<WireMessage>& wire_message);
+    bool parseMessage(google::protobuf::Message& message, const char* data, uint32_t size);
+    void deferParsing(ReceivedMessage& received, WireMessage& wire_message);
+    bool openSpillFile();
+    void releaseInOrder(uint32_t sequence, ReceivedMessage received);
+    void clearReorderBuffer();
+    bool beginSession();
+    void resumeSession(uint32_t announced_session_id, uint32_t peer_received);
+    void retainForResume(const std::list<MessagePtr>& messages, const std::vector<Correlation>& frame_correlations);
+    void acknowledgeFrames(uint32_t peer_received);
+    bool sendAcknowledgement(bool force);
+    void clearSession();
+    void queueReceivedMessage(ReceivedMessage received);
+    void dispatchReceivedMessage(ReceivedMessage received, const Correlation& correlation);
+    bool popReceivedMessage(ReceivedMessage& received);
+    MessagePtr completeReceivedMessage(ReceivedMessage& received);
+    MessagePtr takeReceivedMessage();
+    void processLocal();
+    bool deliverLocal(std::list<MessagePtr>& messages, const std::vector<Correlation>& frame_correlations);
+    void closeLocal();
     void checkConnectionState();
+    bool receivePaused();
+    std::size_t receiveLowWaterMark() const;
+    void wakeReceiving();
+    void notifySelectors();
+    bool hasPendingMessages();
 
 #ifdef ARCUS_DEBUG
     void debug(const std::string& message);
@@ -80,37 +242,186 @@ public:
     void error(ErrorCode error_code, const std::string& message);
     void fatalError(ErrorCode error_code, const std::string& msg);
 
-    SocketState state;
-    SocketState next_state;
+    // Atomic since other threads request state changes, for example close() or a peer in the same process.
+    std::atomic<SocketState> state;
+    std::atomic<SocketState> next_state;
 
-    bool received_close;
+    std::atomic<bool> received_close;
 
     std::string address;
     uint16_t port;
 
     std::thread* thread;
+    // Wakes up the worker thread when it waits for incoming data, -1 when it could not be created.
+    PlatformSocket notifier;
+
+    // When embedded, the caller drives process() from its own event loop and no thread is created.
+    bool embedded;
+    // Is a non-blocking connect still in progress?
+    bool connect_pending;
+    // Serialized frames that could not be written yet without blocking, used in embedded mode.
+    std::string send_buffer;
+    std::size_t send_buffer_offset;
 
     std::list<SocketListener*> listeners;
 
-    MessageTypeStore message_types;
+    SocketOptions options;
+    // The kernel buffer sizes as last reported, used to decide when adaptive buffers should grow.
+    std::size_t kernel_send_buffer_size;
+    std::size_t kernel_receive_buffer_size;
+
+    // The types registered with this socket itself, null while it uses a shared store.
+    std::shared_ptr<MessageTypeStore> own_message_types;
+    // The store types are looked up in, either own_message_types or one set with Socket::setMessageTypeStore().
+    std::shared_ptr<const MessageTypeStore> message_types;
+
+    // Get the store to register types with, reporting an error if the socket uses a shared store.
+    MessageTypeStore* registrationStore();
 
     std::shared_ptr<Arcus::Private::WireMessage> current_message;
 
+    /**
+     * An additional TCP connection that carries part of the frames of this socket.
+     */
+    struct Stream
+    {
+        PlatformSocket socket;
+        std::shared_ptr<WireMessage> current_message;
+    };
+
+    // The amount of TCP connections to spread frames over, both sides need to use the same amount.
+    unsigned stream_count;
+    // The connections beyond platform_socket.
+    std::vector<std::unique_ptr<Stream>> extra_streams;
+    // Sequence numbers used to restore the order of frames spread over several streams.
+    uint32_t next_send_sequence;
+    uint32_t next_receive_sequence;
+    // Messages that arrived before the ones preceding them, by sequence number. Failed frames are stored without a message.
+    std::unordered_map<uint32_t, ReceivedMessage> reorder_buffer;
+    // The amount of streams the other side has requested to close.
+    std::size_t close_requests_received;
+
+    // Keep sent frames until the other side acknowledges them, so they can be replayed after a reconnect.
+    bool session_resume;
+    // Are we the side that connects? That side decides the session id.
+    bool session_initiator;
+    // Identifies the session across connections, 0 if there is none yet.
+    uint32_t session_id;
+    // The session id announced by the other side on the current connection.
+    uint32_t peer_session_id;
+    // Has the other side announced its session on the current connection? Nothing is sent before it did.
+    bool session_established;
+    // Set when the session ended on purpose, so reset() starts a new one.
+    std::atomic<bool> session_finished;
+    // The amount of frames sent and received in this session, wrapping around.
+    uint32_t frames_sent;
+    uint32_t frames_received;
+    // The value of frames_received we last acknowledged.
+    uint32_t frames_acknowledged;
+    // The frames the other side did not acknowledge yet, the last one being frame frames_sent - 1.
+    std::deque<std::pair<MessagePtr, Correlation>> unacknowledged;
+
     std::deque<MessagePtr> sendQueue;
     std::mutex sendQueueMutex;
-    std::deque<MessagePtr> receiveQueue;
+    // When each message in sendQueue was queued, its size, tracker and tag. Guarded by sendQueueMutex.
+    std::deque<QueueEntry> send_queue_entries;
+    // The serialized size of the messages in sendQueue. Guarded by sendQueueMutex.
+    std::size_t send_queue_bytes;
+    // Written messages waiting for an acknowledgement, by frame number. Only used by the worker.
+    std::deque<std::pair<uint32_t, std::shared_ptr<SendTracker>>> awaiting_acknowledgement;
+    // Trackers of the messages in the send buffer of an embedded socket, reported once the buffer is flushed.
+    std::vector<std::shared_ptr<SendTracker>> buffered_trackers;
+    // The channel tagged messages that arrive are handed to, if any.
+    RpcChannel* rpc_channel;
+    std::mutex rpc_channel_mutex;
+    std::deque<ReceivedMessage> receiveQueue;
     std::mutex receiveQueueMutex;
+    // The length and serialized size of receiveQueue, changed with receiveQueueMutex locked so the worker can read them without.
+    std::atomic<std::size_t> receive_queue_length;
+    std::atomic<std::size_t> receive_queue_bytes;
+    // The part of receive_queue_bytes that is in spill_file.
+    std::atomic<std::size_t> receive_queue_spilled_bytes;
+    // Holds deferred messages beyond SocketOptions::receive_memory_limit, created when first needed.
+    std::unique_ptr<Arcus::Private::SpillFile> spill_file;
+    // Set when spill_file could not be created, so it is not tried for every message.
+    bool spill_failed;
 
     std::mutex receiveQueueMutexBlock;
+    // Coroutines waiting in Socket::receive(), in the order they started waiting. Guarded by receiveQueueMutex.
+    std::deque<ReceiveAwaitable*> receive_waiters;
     std::condition_variable message_received_condition_variable;
 
     Arcus::Private::PlatformSocket platform_socket;
 
-    Error last_error;
-
-    std::chrono::system_clock::time_point last_keep_alive_sent;
+    // Set when connected to another socket in the same process instead of over the network.
+    std::shared_ptr<LocalChannel> local_channel;
+    // Messages handed over by the peer in the same process, guarded by sendQueueMutex.
+    std::deque<std::pair<MessagePtr, Correlation>> local_inbox;
+    // Wakes up the worker of an in-process connection when there is something to do.
+    std::condition_variable local_condition;
 
-    static const int keep_alive_rate = 500; // Number of milliseconds between sending keepalive packets
+    Error last_error;
+    // Guards last_error and serializes reporting errors, which with duplex threads happens on both the worker and the reader thread.
+    // Recursive, since listeners may ask for the last error while they are told about it.
+    mutable std::recursive_mutex error_mutex;
+
+    std::list<SocketSelector*> selectors;
+    std::mutex selectors_mutex;
+    // Incremented for every event a selector should report, so selectors can tell whether anything happened.
+    std::atomic<uint32_t> event_serial;
+
+    // When we last wrote to or read from the connection, to only probe an idle connection and detect a silent peer.
+    // Atomic since with duplex threads they are written and read by different threads.
+    std::atomic<std::chrono::steady_clock::time_point> last_send_time;
+    std::atomic<std::chrono::steady_clock::time_point> last_receive_time;
+
+    // With duplex threads, the thread that reads the connection while the worker thread writes it.
+    std::thread reader_thread;
+    // Wakes up the reader thread when it should stop.
+    PlatformSocket reader_notifier;
+    // Set while reading is paused because the receive queue reached its high-water mark. Only changed by the thread reading the connection.
+    std::atomic<bool> receive_paused;
+    // Wakes up the reader thread once the application took enough messages to resume reading.
+    std::mutex receive_resume_mutex;
+    std::condition_variable receive_resume_condition;
+    // A ping the reader thread received, to be answered by the worker thread, which does all the writing.
+    std::atomic<bool> pong_pending;
+    std::atomic<uint32_t> pong_token;
+    // Set when the reader thread ran out of memory. The worker thread then fails the connection, since it may be writing to it.
+    std::atomic<bool> reader_out_of_memory;
+
+    // The round trip probe that is waiting for an answer, if any. Guarded by round_trip_mutex.
+    std::mutex round_trip_mutex;
+    bool ping_outstanding;
+    uint32_t ping_token;
+    std::chrono::steady_clock::time_point ping_sent_time;
+    std::chrono::steady_clock::time_point last_round_trip_sample;
+    // Smoothed round trip time in microseconds, 0 until measured. Read by the application from other threads.
+    std::atomic<int64_t> smoothed_round_trip_time;
+
+    // When the close handshake gives up, unset until the socket starts closing.
+    std::chrono::steady_clock::time_point close_deadline;
+    // Did everything we queued reach the other side when closing?
+    bool close_flushed;
+    // Fulfilled once the socket is closed, see Socket::closeAsync().
+    std::vector<std::promise<bool>> close_promises;
+    std::mutex close_mutex;
+
+    Arcus::Private::StatisticsCollector statistics;
+    // How often listeners get the statistics, 0 for never.
+    std::atomic<std::chrono::milliseconds> statistics_interval;
+    std::chrono::steady_clock::time_point last_statistics_report;
+
+    // Account for the first count messages taken from sendQueue, recording how long they waited if they are sent. Call with sendQueueMutex locked.
+    // Their trackers and tags are added to frame_trackers and frame_correlations in the same order, unless none of them has one.
+    void sendQueueTaken(std::size_t count, bool sent, std::vector<std::shared_ptr<SendTracker>>& frame_trackers, std::vector<Correlation>* frame_correlations = nullptr);
+    // Give listeners a snapshot of the statistics if the interval passed.
+    void reportStatistics();
+
+    // Records the stages messages pass, only set while tracing, see Socket::setTracing().
+    std::unique_ptr<Arcus::Private::MessageTracer> tracer;
+    // Records the frames sent and received, only set while capturing, see Socket::setCapture().
+    std::unique_ptr<Arcus::Private::CaptureWriter> capture;
 
     // This value determines when protobuf should warn about very large messages.
     static const int message_size_warning = 400 * 1048576;
@@ -124,6 +435,7 @@ public:
 void Socket::Private::debug(const std::string& message)
 {
     Error error(ErrorCode::Debug, std::string("[DEBUG] ") + message);
+    std::lock_guard<std::recursive_mutex> lock(error_mutex);
     for (auto listener : listeners)
     {
         listener->error(error);
@@ -137,11 +449,24 @@ void Socket::Private::error(ErrorCode error_code, const std::string& message)
     Error error(error_code, message);
     error.setNativeErrorCode(platform_socket.getNativeErrorCode());
 
-    last_error = error;
+    {
+        std::lock_guard<std::recursive_mutex> lock(error_mutex);
+        last_error = error;
+        if (error_code != ErrorCode::Debug)
+        {
+            statistics.errorReported(false);
+        }
 
-    for (auto listener : listeners)
+        for (auto listener : listeners)
+        {
+            listener->error(error);
+        }
+    }
+
+    // There is nothing to act on for debug messages, so they do not wake up selectors.
+    if (error_code != ErrorCode::Debug)
     {
-        listener->error(error);
+        notifySelectors();
     }
 }
 
@@ -152,15 +477,33 @@ void Socket::Private::fatalError(ErrorCode error_code, const std::string& messag
     error.setFatalError(true);
     error.setNativeErrorCode(platform_socket.getNativeErrorCode());
 
-    last_error = error;
-
     platform_socket.close();
+    closeExtraStreams();
     next_state = SocketState::Error;
 
-    for (auto listener : listeners)
     {
-        listener->error(error);
+        std::lock_guard<std::recursive_mutex> lock(error_mutex);
+        last_error = error;
+        statistics.errorReported(true);
+
+        for (auto listener : listeners)
+        {
+            listener->error(error);
+        }
+    }
+
+    notifySelectors();
+}
+
+MessageTypeStore* Socket::Private::registrationStore()
+{
+    if (! own_message_types)
+    {
+        // A shared store may be in use by other sockets on other threads, so it must not change.
+        error(ErrorCode::MessageRegistrationFailedError, "Socket uses a shared message type store");
+        return nullptr;
     }
+    return own_message_types.get();
 }
 
 // Thread run method.
@@ -168,408 +511,2196 @@ void Socket::Private::run()
 {
     while (state != SocketState::Closed && state != SocketState::Error)
     {
-        switch (state)
+        process();
+    }
+
+    message_received_condition_variable.notify_all();
+}
+
+// Perform one step of the state machine.
+// In threaded mode this blocks for a limited time, in embedded mode it only does what is possible without blocking.
+void Socket::Private::process()
+{
+    // Apply a state change requested from outside the state machine before doing any work for the old state.
+    if (next_state != state)
+    {
+        updateState();
+        return;
+    }
+
+    switch (state)
+    {
+    case SocketState::Connecting:
+    {
+        if (local_channel)
         {
-        case SocketState::Connecting:
+            next_state = SocketState::Connected;
+        }
+        else if (embedded && connect_pending)
         {
-            if (! platform_socket.create())
+            if (! platform_socket.waitForWritable(0))
             {
-                fatalError(ErrorCode::CreationError, "Could not create a socket");
+                break;
             }
-            else if (! platform_socket.connect(address, port))
+
+            connect_pending = false;
+            if (platform_socket.takePendingError() != 0)
             {
                 fatalError(ErrorCode::ConnectFailedError, "Could not connect to the given address");
             }
             else
             {
-                if (! platform_socket.setReceiveTimeout(250))
-                {
-                    fatalError(ErrorCode::ConnectFailedError, "Failed to set socket receive timeout");
-                }
-                else
-                {
-                    DEBUG("Socket connected");
-                    next_state = SocketState::Connected;
-                }
+                DEBUG("Socket connected");
+                next_state = SocketState::Connected;
             }
-            break;
         }
-        case SocketState::Opening:
+        else if (! createSocket(platform_socket))
         {
-            if (! platform_socket.create())
+            fatalError(ErrorCode::CreationError, "Could not create a socket");
+        }
+        else if (embedded && ! platform_socket.setBlocking(false))
+        {
+            fatalError(ErrorCode::CreationError, "Could not make the socket non-blocking");
+        }
+        else if (! platform_socket.connect(address, port))
+        {
+            if (embedded && platform_socket.wouldBlock())
+            {
+                connect_pending = true;
+            }
+            else
+            {
+                fatalError(ErrorCode::ConnectFailedError, "Could not connect to the given address");
+            }
+        }
+        else if (embedded)
+        {
+            DEBUG("Socket connected");
+            next_state = SocketState::Connected;
+        }
+        else
+        {
+            if (! platform_socket.setReceiveTimeout(250) || ! platform_socket.setSendTimeout(250))
+            {
+                fatalError(ErrorCode::ConnectFailedError, "Failed to set socket receive timeout");
+            }
+            else if (! connectExtraStreams())
             {
-                fatalError(ErrorCode::CreationError, "Could not create a socket");
+                fatalError(ErrorCode::ConnectFailedError, "Could not connect the additional streams");
             }
-            else if (! platform_socket.bind(address, port))
+            else if (session_resume && ! beginSession())
             {
-                fatalError(ErrorCode::BindFailedError, "Could not bind to the given address and port");
+                fatalError(ErrorCode::ConnectFailedError, "Could not start the session");
             }
             else
             {
-                next_state = SocketState::Listening;
+                DEBUG("Socket connected");
+                next_state = SocketState::Connected;
             }
-            break;
         }
-        case SocketState::Listening:
+        break;
+    }
+    case SocketState::Opening:
+    {
+        // Buffer sizes set on the listening socket are inherited by the accepted connections.
+        if (! createSocket(platform_socket))
+        {
+            fatalError(ErrorCode::CreationError, "Could not create a socket");
+        }
+        else if (! platform_socket.bind(address, port))
+        {
+            fatalError(ErrorCode::BindFailedError, "Could not bind to the given address and port");
+        }
+        else if (embedded && ! platform_socket.setBlocking(false))
+        {
+            fatalError(ErrorCode::CreationError, "Could not make the socket non-blocking");
+        }
+        else
+        {
+            next_state = SocketState::Listening;
+        }
+        break;
+    }
+    case SocketState::Listening:
+    {
+        platform_socket.listen(static_cast<int>(stream_count));
+        if (! acceptExtraStreams())
+        {
+            fatalError(ErrorCode::AcceptFailedError, "Could not accept the additional streams");
+        }
+        else if (! platform_socket.accept())
         {
-            platform_socket.listen(1);
-            if (! platform_socket.accept())
+            if (! embedded || ! platform_socket.wouldBlock())
             {
                 fatalError(ErrorCode::AcceptFailedError, "Could not accept the incoming connection");
             }
+        }
+        else if (embedded)
+        {
+            applyOptions(platform_socket);
+
+            // Accepted sockets do not inherit the non-blocking flag everywhere.
+            if (! platform_socket.setBlocking(false))
+            {
+                fatalError(ErrorCode::AcceptFailedError, "Could not make the socket non-blocking");
+            }
             else
             {
-                if (! platform_socket.setReceiveTimeout(250))
-                {
-                    fatalError(ErrorCode::AcceptFailedError, "Could not set receive timeout of socket");
-                }
-                else
-                {
-                    DEBUG("Socket connected");
-                    next_state = SocketState::Connected;
-                }
+                DEBUG("Socket connected");
+                next_state = SocketState::Connected;
             }
-            break;
         }
-        case SocketState::Connected:
+        else
         {
-            // Get all the messages from the queue and store them in a temporary array so we can
-            // unlock the queue before performing the send.
-            std::list<MessagePtr> messagesToSend;
-            sendQueueMutex.lock();
-            while (sendQueue.size() > 0)
+            applyOptions(platform_socket);
+
+            if (! platform_socket.setReceiveTimeout(250) || ! platform_socket.setSendTimeout(250))
             {
-                messagesToSend.push_back(sendQueue.front());
-                sendQueue.pop_front();
+                fatalError(ErrorCode::AcceptFailedError, "Could not set receive timeout of socket");
             }
-            sendQueueMutex.unlock();
+            else if (session_resume && ! beginSession())
+            {
+                fatalError(ErrorCode::AcceptFailedError, "Could not start the session");
+            }
+            else
+            {
+                DEBUG("Socket connected");
+                next_state = SocketState::Connected;
+            }
+        }
+        break;
+    }
+    case SocketState::Connected:
+    {
+        if (local_channel)
+        {
+            processLocal();
+            break;
+        }
+
+        // Get all the messages from the queue and store them in a temporary array so we can
+        // unlock the queue before performing the send.
+        // In a session, everything stays queued until we know what the other side already has.
+        std::list<MessagePtr> messagesToSend;
+        std::vector<std::shared_ptr<SendTracker>> frame_trackers;
+        std::vector<Correlation> frame_correlations;
+        sendQueueMutex.lock();
+        while (sendQueue.size() > 0 && (! session_resume || session_established))
+        {
+            messagesToSend.push_back(sendQueue.front());
+            sendQueue.pop_front();
+        }
+        sendQueueTaken(messagesToSend.size(), true, frame_trackers, &frame_correlations);
+        sendQueueMutex.unlock();
 
+        if (embedded)
+        {
+            std::size_t index = 0;
             for (auto message : messagesToSend)
             {
-                sendMessage(message);
+                appendMessage(message, frame_correlations.empty() ? Correlation() : frame_correlations[index++]);
             }
+            buffered_trackers.insert(buffered_trackers.end(), frame_trackers.begin(), frame_trackers.end());
 
-            receiveNextMessage();
-
-            if (next_state != SocketState::Error)
+            if (! flushSendBuffer())
             {
-                checkConnectionState();
+                break;
             }
 
-            break;
+            // Handle everything that already arrived, but bound the amount of work so other sockets get their turn.
+            for (int i = 0; i < 64 && next_state == SocketState::Connected && ! receivePaused() && platform_socket.waitForReadable(0); ++i)
+            {
+                receiveNextMessage(platform_socket, current_message);
+            }
         }
-        case SocketState::Closing:
+        else
         {
-            if (! received_close)
+            if (! reader_thread.joinable() && useDuplexThreads())
+            {
+                startReader();
+            }
+
+            const uint32_t first_frame = frames_sent;
+            if (session_resume)
+            {
+                retainForResume(messagesToSend, frame_correlations);
+            }
+            const bool written = sendMessages(messagesToSend, frame_correlations);
+            reportWritten(frame_trackers, first_frame, written);
+
+            if (reader_out_of_memory)
+            {
+                fatalError(ErrorCode::ReceiveFailedError, "Out of memory");
+                break;
+            }
+            else if (! reader_thread.joinable() && ! receivePaused())
             {
-                // We want to close the socket.
-                // First, flush the send queue so it is empty.
-                std::list<MessagePtr> messagesToSend;
-                sendQueueMutex.lock();
-                while (sendQueue.size() > 0)
+                receiveFromStreams();
+            }
+            else
+            {
+                if (pong_pending.exchange(false) && ! writeControl(SOCKET_PONG, pong_token))
                 {
-                    messagesToSend.push_back(sendQueue.front());
-                    sendQueue.pop_front();
+                    error(ErrorCode::ConnectionResetError, "Connection reset by peer");
+                    next_state = SocketState::Closing;
                 }
-                sendQueueMutex.unlock();
 
-                for (auto message : messagesToSend)
+                // Reading is up to the reader thread or paused, so only wait for something to send.
+                PlatformSocket* wait_for = &notifier;
+                bool woken = false;
+                if (notifier.getNativeHandle() == -1)
                 {
-                    sendMessage(message);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
                 }
-
-                // Communicate to the other side that we want to close.
-                platform_socket.writeUInt32(SOCKET_CLOSE);
-                // Disable further writing to the socket.
-                error(ErrorCode::Debug, "We got a request to close the socket.");
-                platform_socket.shutdown(PlatformSocket::ShutdownDirection::ShutdownWrite);
-
-                // Wait until we receive confirmation from the other side to actually close.
-                uint32_t data = 0;
-                while (data != SOCKET_CLOSE && next_state == SocketState::Closing)
+                else if (PlatformSocket::waitForAnyReadable(&wait_for, 1, 250, &woken) && woken)
                 {
-                    if (platform_socket.readUInt32(&data) == -1)
-                    {
-                        break;
-                    }
+                    notifier.clearNotifications();
                 }
             }
-            else
-            {
-                // The other side requested a close. Drop all pending messages
-                // since the other socket will not process them anyway.
-                sendQueueMutex.lock();
-                sendQueue.clear();
-                sendQueueMutex.unlock();
 
-                // Send confirmation to the other side that we received their close
-                // request and are also closing down.
-                platform_socket.writeUInt32(SOCKET_CLOSE);
-                // Prevent further writing to the socket.
-                platform_socket.shutdown(PlatformSocket::ShutdownDirection::ShutdownWrite);
-
-                // At this point the socket can safely be closed, assuming that SOCKET_CLOSE
-                // is the last data received from the other socket and everything was received
-                // in order (which should be guaranteed by TCP).
+            if (session_resume && session_established)
+            {
+                sendAcknowledgement(false);
             }
+        }
 
-            error(ErrorCode::Debug, "Closing socket because other side requested close.");
-            platform_socket.close();
-            next_state = SocketState::Closed;
-            break;
+        if (next_state != SocketState::Error)
+        {
+            checkConnectionState();
         }
-        default:
+
+        break;
+    }
+    case SocketState::Closing:
+    {
+        if (local_channel)
+        {
+            closeLocal();
             break;
         }
 
-        if (next_state != state)
+        if (embedded)
         {
-            state = next_state;
+            // The close handshake is performed synchronously, like in threaded mode.
+            platform_socket.setBlocking(true);
+            platform_socket.setReceiveTimeout(250);
+        }
+        limitCloseToDeadline();
 
-            for (auto listener : listeners)
+        if (embedded)
+        {
+            if (received_close)
+            {
+                close_flushed = close_flushed && send_buffer_offset == send_buffer.size();
+                send_buffer.clear();
+                send_buffer_offset = 0;
+            }
+            else if (! flushSendBuffer() || send_buffer_offset < send_buffer.size())
             {
-                listener->stateChanged(state);
+                close_flushed = false;
             }
         }
-    }
 
-    message_received_condition_variable.notify_all();
-}
+        if (! received_close)
+        {
+            // We want to close the socket.
+            // First, flush the send queue so it is empty. Whatever is still queued at the deadline is dropped.
+            // When the connection is lost in the middle of a session, keep the queue for when it resumes.
+            const bool keep_for_resume = session_resume && ! session_finished;
+            std::list<MessagePtr> messagesToSend;
+            std::vector<std::shared_ptr<SendTracker>> frame_trackers;
+            std::vector<Correlation> frame_correlations;
+            std::vector<std::shared_ptr<SendTracker>> dropped_trackers;
+            sendQueueMutex.lock();
+            if (! keep_for_resume && std::chrono::steady_clock::now() < close_deadline)
+            {
+                messagesToSend.assign(sendQueue.begin(), sendQueue.end());
+                sendQueue.clear();
+                sendQueueTaken(messagesToSend.size(), true, frame_trackers, &frame_correlations);
+            }
+            else if (! keep_for_resume && ! sendQueue.empty())
+            {
+                sendQueue.clear();
+                sendQueueTaken(send_queue_entries.size(), false, dropped_trackers);
+                close_flushed = false;
+            }
+            sendQueueMutex.unlock();
+            reportWritten(dropped_trackers, frames_sent, false);
 
-// Send a message to the connected socket.
-void Socket::Private::sendMessage(const MessagePtr& message)
-{
-    const uint32_t header = (ARCUS_SIGNATURE << 16) | (VERSION_MAJOR << 8) | (VERSION_MINOR);
-    if (platform_socket.writeUInt32(header) == -1)
-    {
-        error(ErrorCode::SendFailedError, "Could not send message header");
-        return;
-    }
+            const bool written = sendMessages(messagesToSend, frame_correlations);
+            reportWritten(frame_trackers, frames_sent, written);
+            if (! written)
+            {
+                close_flushed = false;
+            }
 
-    const size_t message_size = message->ByteSizeLong();
-    if (platform_socket.writeUInt32(static_cast<uint32_t>(message_size)) == -1)
-    {
-        error(ErrorCode::SendFailedError, "Could not send message size");
-        return;
-    }
+            // Communicate to the other side that we want to close.
+            // Disable further writing to the socket.
+            for (std::size_t i = 0; i < extra_streams.size() + 1; ++i)
+            {
+                if (streamSocket(i).writeUInt32(SOCKET_CLOSE) == -1)
+                {
+                    close_flushed = false;
+                }
+                streamSocket(i).shutdown(PlatformSocket::ShutdownDirection::ShutdownWrite);
+            }
+            error(ErrorCode::Debug, "We got a request to close the socket.");
 
-    const uint32_t type_id = message_types.getMessageTypeId(message);
-    if (platform_socket.writeUInt32(type_id) == -1)
-    {
-        error(ErrorCode::SendFailedError, "Could not send message type");
-        return;
+            // Wait until we receive confirmation from the other side to actually close, but not past the deadline.
+            uint32_t data = 0;
+            while (data != SOCKET_CLOSE && next_state == SocketState::Closing && std::chrono::steady_clock::now() < close_deadline)
+            {
+                if (platform_socket.readUInt32(&data) == -1)
+                {
+                    break;
+                }
+            }
+
+            if (data != SOCKET_CLOSE)
+            {
+                error(ErrorCode::Debug, "The other side did not confirm closing in time");
+                close_flushed = false;
+            }
+        }
+        else
+        {
+            // The other side requested a close. Drop all pending messages
+            // since the other socket will not process them anyway.
+            std::vector<std::shared_ptr<SendTracker>> dropped_trackers;
+            sendQueueMutex.lock();
+            close_flushed = close_flushed && sendQueue.empty();
+            sendQueue.clear();
+            sendQueueTaken(send_queue_entries.size(), false, dropped_trackers);
+            sendQueueMutex.unlock();
+            reportWritten(dropped_trackers, frames_sent, false);
+
+            // Send confirmation to the other side that we received their close
+            // request and are also closing down.
+            // Prevent further writing to the socket.
+            for (std::size_t i = 0; i < extra_streams.size() + 1; ++i)
+            {
+                streamSocket(i).writeUInt32(SOCKET_CLOSE);
+                streamSocket(i).shutdown(PlatformSocket::ShutdownDirection::ShutdownWrite);
+            }
+
+            // At this point the socket can safely be closed, assuming that SOCKET_CLOSE
+            // is the last data received from the other socket and everything was received
+            // in order (which should be guaranteed by TCP).
+        }
+
+        error(ErrorCode::Debug, "Closing socket because other side requested close.");
+        platform_socket.close();
+        closeExtraStreams();
+        next_state = SocketState::Closed;
+        break;
+    }
+    default:
+        break;
     }
 
-    const std::string data = message->SerializeAsString();
-    if (platform_socket.writeBytes(data.size(), data.data()) == -1)
+    if (state == SocketState::Connected)
     {
-        error(ErrorCode::SendFailedError, "Could not send message data");
-        return;
+        reportStatistics();
     }
 
-    DEBUG(std::string("Sent message of type ") + std::to_string(type_id) + " and size " + std::to_string(message_size));
+    updateState();
 }
 
-// Handle receiving data until we have a proper message.
-void Socket::Private::receiveNextMessage()
+// Make sure closing cannot take longer than the deadline, including writes that block.
+void Socket::Private::limitCloseToDeadline()
 {
-    socket_size result = 0;
-
-    if (! current_message)
+    const auto now = std::chrono::steady_clock::now();
+    if (close_deadline == std::chrono::steady_clock::time_point())
     {
-        current_message = std::make_shared<WireMessage>();
+        close_deadline = now + std::chrono::milliseconds(options.close_timeout);
     }
 
-    if (current_message->state == WireMessage::MessageState::Header)
+    // Blocking writes wake up regularly to check the deadline.
+    for (std::size_t i = 0; i < extra_streams.size() + 1; ++i)
     {
-        uint32_t header = 0;
-        platform_socket.readUInt32(&header);
+        streamSocket(i).setSendTimeout(250);
+        streamSocket(i).setWriteDeadline(close_deadline);
+    }
+}
 
-        if (header == 0) // Keep-alive, just return
+// Move to the next state, notifying listeners if it changed.
+void Socket::Private::updateState()
+{
+    if (next_state != state)
+    {
+        if (reader_thread.joinable())
         {
-            return;
+            // The reader only works while connected. Closing reads the remainder of the connection itself.
+            stopReader();
         }
-        else if (header == SOCKET_CLOSE)
+
+        state = next_state.load();
+
+        if (state == SocketState::Connected)
         {
-            // We received a close request from the other socket, so close this socket as well.
-            next_state = SocketState::Closing;
-            received_close = true;
-            return;
+            // Liveness is tracked per connection.
+            const auto now = std::chrono::steady_clock::now();
+            last_send_time = now;
+            last_receive_time = now;
+            last_round_trip_sample = now;
+            ping_outstanding = false;
+            pong_pending = false;
+            reader_out_of_memory = false;
+            smoothed_round_trip_time = 0;
+            close_deadline = std::chrono::steady_clock::time_point();
+            close_flushed = true;
         }
 
-        uint32_t signature = (header & 0xffff0000) >> 16;
-        uint32_t major_version = (header & 0x0000ff00) >> 8;
-        uint32_t minor_version = header & 0x000000ff;
+        for (auto listener : listeners)
+        {
+            listener->stateChanged(state);
+        }
 
-        if (signature != ARCUS_SIGNATURE)
+        if (state == SocketState::Closed || state == SocketState::Error)
         {
-            // Someone might be speaking to us in a different protocol?
-            error(ErrorCode::ReceiveFailedError, "Header mismatch");
-            current_message.reset();
-            platform_socket.flush();
-            return;
+            std::lock_guard<std::mutex> lock(close_mutex);
+            for (auto& promise : close_promises)
+            {
+                promise.set_value(state == SocketState::Closed && close_flushed);
+            }
+            close_promises.clear();
         }
 
-        if (major_version != VERSION_MAJOR)
+        if (state == SocketState::Closed || state == SocketState::Error)
         {
-            error(ErrorCode::ReceiveFailedError, "Protocol version mismatch");
-            current_message.reset();
-            platform_socket.flush();
-            return;
+            failTrackedSends(session_resume && ! session_finished);
+            resumeReceivers();
+            if (capture)
+            {
+                // So the capture of a finished connection can be replayed right away.
+                capture->flush();
+            }
         }
 
-        if (minor_version != VERSION_MINOR)
         {
-            error(ErrorCode::ReceiveFailedError, "Protocol version mismatch");
-            current_message.reset();
-            platform_socket.flush();
-            return;
+            std::lock_guard<std::mutex> lock(rpc_channel_mutex);
+            if (rpc_channel)
+            {
+                rpc_channel->stateChanged(state);
+            }
         }
 
-        DEBUG("Incoming message, header ok");
-        current_message->state = WireMessage::MessageState::Size;
+        notifySelectors();
     }
+}
 
-    if (current_message->state == WireMessage::MessageState::Size)
+// Send messages to the connected socket, returns false if they could not all be written.
+// All frames are handed to the platform socket at once, so a batch costs a single system call instead of four per message.
+bool Socket::Private::sendMessages(const std::list<MessagePtr>& messages, const std::vector<Correlation>& frame_correlations)
+{
+    if (messages.empty())
     {
-        uint32_t size = 0;
-        result = platform_socket.readUInt32(&size);
-        if (result == 0)
-        {
-            return;
-        }
-        else if (result == -1)
+        return true;
+    }
+
+    const uint32_t header = htonl((ARCUS_SIGNATURE << 16) | (VERSION_MAJOR << 8) | (VERSION_MINOR));
+
+    // With several streams, frames are spread round-robin and prefixed with a sequence number.
+    const std::size_t streams = extra_streams.size() + 1;
+
+    // Room for a sequence prefix, a call tag and the frame header. Reserved up front so the buffers can point into them.
+    std::vector<std::array<uint32_t, 7>> frame_headers;
+    std::vector<std::string> payloads;
+    frame_headers.reserve(messages.size());
+    payloads.reserve(messages.size());
+
+    std::vector<std::vector<WriteBuffer>> buffers(streams);
+    std::size_t largest_frame = 0;
+    std::size_t index = 0;
+    for (const auto& message : messages)
+    {
+        const Correlation correlation = frame_correlations.empty() ? Correlation() : frame_correlations[index++];
+        const uint32_t message_size = static_cast<uint32_t>(message->ByteSizeLong());
+        largest_frame = std::max<std::size_t>(largest_frame, message_size);
+        const uint32_t type_id = message_types->getMessageTypeId(message);
+        statistics.messageSent(type_id, message_size);
+        if (tracer)
         {
-            error(ErrorCode::ReceiveFailedError, "Size invalid");
-            current_message.reset();
-            platform_socket.flush();
-            return;
+            tracer->record(MessageTracer::Event::WriteStart, message.get(), type_id, message_size);
         }
 
-        DEBUG(std::string("Incoming message size: ") + std::to_string(size));
-        current_message->size = size;
-        current_message->state = WireMessage::MessageState::Type;
+        auto& words = frame_headers.emplace_back();
+        std::size_t word_count = 0;
+        std::size_t stream = 0;
+        if (streams > 1)
+        {
+            stream = next_send_sequence % streams;
+            words[word_count++] = htonl(SOCKET_SEQUENCE);
+            words[word_count++] = htonl(next_send_sequence++);
+        }
+        if (correlation.control != 0)
+        {
+            words[word_count++] = htonl(correlation.control);
+            words[word_count++] = htonl(correlation.call_id);
+        }
+        words[word_count++] = header;
+        words[word_count++] = htonl(message_size);
+        words[word_count++] = htonl(type_id);
+        payloads.push_back(message->SerializeAsString());
+        if (capture)
+        {
+            capture->write(CapturedFrame::Direction::Sent, ntohl(header), type_id, payloads.back().data(), payloads.back().size());
+        }
+
+        buffers[stream].push_back({ reinterpret_cast<const char*>(words.data()), word_count * sizeof(uint32_t) });
+        buffers[stream].push_back({ payloads.back().data(), payloads.back().size() });
+
+        DEBUG(std::string("Sending message of type ") + std::to_string(type_id) + " and size " + std::to_string(message_size));
     }
 
-    if (current_message->state == WireMessage::MessageState::Type)
+    growBuffers(largest_frame, true);
+
+    for (std::size_t i = 0; i < streams; ++i)
     {
-        uint32_t type = 0;
-        result = platform_socket.readUInt32(&type);
-        if (result == 0)
+        if (buffers[i].empty())
         {
-            return;
+            continue;
         }
-        else if (result == -1)
+
+        // Corking makes the whole batch leave in full segments, uncorking sends the remainder right away.
+        const bool corked = options.cork && buffers[i].size() > 2 && streamSocket(i).setCorked(true);
+        const socket_size written = streamSocket(i).writeBuffers(buffers[i].data(), buffers[i].size());
+        if (corked)
         {
-            error(ErrorCode::ReceiveFailedError, "Receiving type failed");
-            current_message->valid = false;
+            streamSocket(i).setCorked(false);
         }
 
-        uint32_t real_type = static_cast<uint32_t>(type);
-
-        try
+        if (written == -1)
         {
-            current_message->allocateData();
+            error(ErrorCode::SendFailedError, "Could not send message data");
+            return false;
         }
-        catch (std::bad_alloc&)
+    }
+
+    if (tracer)
+    {
+        const int64_t written_time = MessageTracer::now();
+        for (const auto& message : messages)
         {
-            // Either way we're in trouble.
-            current_message.reset();
-            fatalError(ErrorCode::ReceiveFailedError, "Out of memory");
-            return;
+            tracer->record(MessageTracer::Event::WriteEnd, message.get(), 0, 0, written_time);
         }
+    }
 
-        DEBUG(std::string("Incoming message type: ") + std::to_string(real_type));
-        current_message->type = real_type;
-        current_message->state = WireMessage::MessageState::Data;
+    last_send_time = std::chrono::steady_clock::now();
+    return true;
+}
+
+// Create a platform socket and apply the configured options to it.
+bool Socket::Private::createSocket(PlatformSocket& socket)
+{
+    if (! socket.create())
+    {
+        return false;
+    }
+
+    applyOptions(socket);
+    return true;
+}
+
+// Apply the configured options to a newly created or accepted socket.
+// None of these are essential, so failures are only reported as debug information.
+void Socket::Private::applyOptions(PlatformSocket& socket)
+{
+    socket.setUseIoUring(options.use_io_uring);
+
+    if (! socket.setNoDelay(options.no_delay))
+    {
+        error(ErrorCode::Debug, "Could not change Nagle's algorithm");
+    }
+    if (options.send_buffer_size > 0 && ! socket.setSendBufferSize(options.send_buffer_size))
+    {
+        error(ErrorCode::Debug, "Could not set send buffer size");
+    }
+    if (options.receive_buffer_size > 0 && ! socket.setReceiveBufferSize(options.receive_buffer_size))
+    {
+        error(ErrorCode::Debug, "Could not set receive buffer size");
+    }
+    if (options.busy_poll > 0 && ! socket.setBusyPoll(options.busy_poll))
+    {
+        error(ErrorCode::Debug, "Could not enable busy polling");
     }
 
-    if (current_message->state == WireMessage::MessageState::Data)
+    if (&socket == &platform_socket)
     {
-        result = platform_socket.readBytes(current_message->getRemainingSize(), &current_message->data[current_message->received_size]);
+        kernel_send_buffer_size = static_cast<std::size_t>(std::max(socket.getSendBufferSize(), 0));
+        kernel_receive_buffer_size = static_cast<std::size_t>(std::max(socket.getReceiveBufferSize(), 0));
+    }
+}
 
-        if (result < 0)
+// Grow the kernel buffers of all streams when adaptive buffers are enabled and frames no longer comfortably fit.
+void Socket::Private::growBuffers(std::size_t frame_size, bool sending)
+{
+    std::size_t& current = sending ? kernel_send_buffer_size : kernel_receive_buffer_size;
+    const std::size_t maximum = static_cast<std::size_t>(std::max(options.max_buffer_size, 0));
+    if (! options.adaptive_buffers || current >= maximum || frame_size * 2 <= current)
+    {
+        return;
+    }
+
+    std::size_t wanted = std::max<std::size_t>(current, 64 * 1024);
+    while (wanted < frame_size * 2 && wanted < maximum)
+    {
+        wanted *= 2;
+    }
+    wanted = std::min(wanted, maximum);
+
+    for (std::size_t i = 0; i < extra_streams.size() + 1; ++i)
+    {
+        if (sending)
         {
-            error(ErrorCode::ReceiveFailedError, "Could not receive data for message");
-            current_message.reset();
-            return;
+            streamSocket(i).setSendBufferSize(static_cast<int>(wanted));
         }
         else
         {
-            current_message->received_size = current_message->received_size + static_cast<uint32_t>(result);
+            streamSocket(i).setReceiveBufferSize(static_cast<int>(wanted));
+        }
+    }
 
-            DEBUG("Received " + std::to_string(result) + " bytes data");
+    DEBUG(std::string(sending ? "Send" : "Receive") + " buffer grown to " + std::to_string(wanted));
+    current = wanted;
+}
 
-            if (current_message->isComplete())
-            {
-                if (! current_message->valid)
-                {
-                    current_message.reset();
-                    return;
-                }
+// Get the platform socket of one of the streams, where stream 0 is platform_socket.
+PlatformSocket& Socket::Private::streamSocket(std::size_t index)
+{
+    return index == 0 ? platform_socket : extra_streams[index - 1]->socket;
+}
 
-                current_message->state = WireMessage::MessageState::Dispatch;
-            }
+// Open the additional connections after platform_socket connected.
+bool Socket::Private::connectExtraStreams()
+{
+    extra_streams.clear();
+    next_send_sequence = 0;
+    next_receive_sequence = 0;
+    clearReorderBuffer();
+    close_requests_received = 0;
+
+    for (unsigned i = 1; i < stream_count; ++i)
+    {
+        auto stream = std::make_unique<Stream>();
+        if (! createSocket(stream->socket) || ! stream->socket.connect(address, port) || ! stream->socket.setReceiveTimeout(250) || ! stream->socket.setSendTimeout(250))
+        {
+            stream->socket.close();
+            closeExtraStreams();
+            return false;
         }
+        extra_streams.push_back(std::move(stream));
     }
+    return true;
+}
+
+// Accept the additional connections, before platform_socket accepts the last one and stops listening.
+bool Socket::Private::acceptExtraStreams()
+{
+    extra_streams.clear();
+    next_send_sequence = 0;
+    next_receive_sequence = 0;
+    clearReorderBuffer();
+    close_requests_received = 0;
 
-    if (current_message->state == WireMessage::MessageState::Dispatch)
+    for (unsigned i = 1; i < stream_count; ++i)
     {
-        handleMessage(current_message);
-        current_message.reset();
+        auto stream = std::make_unique<Stream>();
+        if (! platform_socket.acceptConnection(stream->socket) || ! stream->socket.setReceiveTimeout(250) || ! stream->socket.setSendTimeout(250))
+        {
+            closeExtraStreams();
+            return false;
+        }
+        applyOptions(stream->socket);
+        extra_streams.push_back(std::move(stream));
     }
+    return true;
 }
 
-// Parse and process a message received on the socket.
-void Socket::Private::handleMessage(const std::shared_ptr<WireMessage>& wire_message)
+void Socket::Private::closeExtraStreams()
 {
-    if (! message_types.hasType(wire_message->type))
+    for (auto& stream : extra_streams)
     {
-        DEBUG(std::string("Received message type: ") + std::to_string(wire_message->type));
-        error(ErrorCode::UnknownMessageTypeError, "Unknown message type " + std::to_string(wire_message->type));
+        stream->socket.close();
+    }
+    extra_streams.clear();
+}
+
+// Wait for data on any of the streams and handle what arrived.
+// The notifier wakes us up early when there is something to send or the socket should close.
+void Socket::Private::receiveFromStreams()
+{
+    const std::size_t streams = extra_streams.size() + 1;
+    if (streams == 1 && notifier.getNativeHandle() == -1)
+    {
+        // Nothing to wait for besides the connection, so just block reading it.
+        receiveNextMessage(platform_socket, current_message);
         return;
     }
 
-    MessagePtr message = message_types.createMessage(wire_message->type);
+    std::vector<PlatformSocket*> sockets(streams);
+    for (std::size_t i = 0; i < streams; ++i)
+    {
+        sockets[i] = &streamSocket(i);
+    }
+    if (notifier.getNativeHandle() != -1)
+    {
+        sockets.push_back(&notifier);
+    }
 
-    google::protobuf::io::ArrayInputStream array(wire_message->data, static_cast<int>(wire_message->size));
-    google::protobuf::io::CodedInputStream stream(&array);
-    stream.SetTotalBytesLimit(message_size_maximum);
-    if (! message->ParseFromCodedStream(&stream))
+    std::unique_ptr<bool[]> readable(new bool[sockets.size()]);
+    if (! PlatformSocket::waitForAnyReadable(sockets.data(), sockets.size(), 250, readable.get()))
     {
-        error(ErrorCode::ParseFailedError, "Failed to parse message:" + std::string(wire_message->data));
         return;
     }
 
-    DEBUG(std::string("Received a message of type ") + std::to_string(wire_message->type) + " and size " + std::to_string(wire_message->size));
+    if (sockets.size() > streams && readable[streams])
+    {
+        notifier.clearNotifications();
+    }
 
-    receiveQueueMutex.lock();
-    receiveQueue.push_back(message);
-    receiveQueueMutex.unlock();
+    for (std::size_t i = 0; i < streams && next_state == SocketState::Connected; ++i)
+    {
+        if (readable[i])
+        {
+            receiveNextMessage(*sockets[i], i == 0 ? current_message : extra_streams[i - 1]->current_message);
+        }
+    }
+}
 
-    for (auto listener : listeners)
+// Should reading be done on a thread of its own? Only used for connections over TCP in threaded mode.
+bool Socket::Private::useDuplexThreads() const
+{
+    // Sessions acknowledge frames from the receiving side, which would make the reader write as well.
+    return options.duplex_threads && ! embedded && ! local_channel && ! session_resume;
+}
+
+// Start reading on a thread of its own, leaving the worker thread to write.
+void Socket::Private::startReader()
+{
+    if (! reader_notifier.createNotifier())
     {
-        listener->messageReceived();
+        error(ErrorCode::Debug, "Could not create a notifier for the reader thread, reading on the worker thread instead");
+        return;
     }
+    reader_thread = std::thread(&Socket::Private::runReader, this);
+}
 
-    message_received_condition_variable.notify_all();
+// Stop the reader thread, waiting for it to finish handling the frame it is reading.
+void Socket::Private::stopReader()
+{
+    reader_notifier.notify();
+    wakeReceiving();
+    reader_thread.join();
+    reader_notifier.close();
 }
 
-// Send a keepalive packet to check whether we are still connected.
-void Socket::Private::checkConnectionState()
+// Thread run method of the reader thread.
+void Socket::Private::runReader()
 {
-    auto now = std::chrono::system_clock::now();
-    auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_keep_alive_sent);
+    const std::size_t streams = extra_streams.size() + 1;
+    std::vector<PlatformSocket*> sockets(streams);
+    for (std::size_t i = 0; i < streams; ++i)
+    {
+        sockets[i] = &streamSocket(i);
+    }
+    sockets.push_back(&reader_notifier);
+    std::unique_ptr<bool[]> readable(new bool[sockets.size()]);
 
-    if (diff.count() > keep_alive_rate)
+    while (next_state == SocketState::Connected && ! reader_out_of_memory)
     {
-        constexpr uint32_t keepalive = 0;
-        if (platform_socket.writeUInt32(keepalive) == -1)
+        if (receivePaused())
+        {
+            // Meanwhile the kernel buffers fill up, which makes TCP slow the other side down.
+            std::unique_lock<std::mutex> lock(receive_resume_mutex);
+            receive_resume_condition.wait_for(lock, std::chrono::milliseconds(250), [this]() { return receive_queue_bytes <= receiveLowWaterMark() || next_state != SocketState::Connected; });
+            continue;
+        }
+
+        if (! PlatformSocket::waitForAnyReadable(sockets.data(), sockets.size(), 250, readable.get()) || readable[streams])
+        {
+            // Woken up to stop, or nothing happened in a while, so check whether we are still connected.
+            continue;
+        }
+
+        for (std::size_t i = 0; i < streams && next_state == SocketState::Connected; ++i)
+        {
+            if (readable[i])
+            {
+                receiveNextMessage(*sockets[i], i == 0 ? current_message : extra_streams[i - 1]->current_message, true);
+            }
+        }
+    }
+
+    // Let the worker thread act on whatever ended the connection right away.
+    wakeWorker();
+}
+
+// Wake up the worker thread, so it acts on newly queued messages or a state change right away.
+void Socket::Private::wakeWorker()
+{
+    if (notifier.getNativeHandle() != -1)
+    {
+        notifier.notify();
+    }
+}
+
+// Serialize a message into the send buffer, to be written by flushSendBuffer().
+void Socket::Private::appendMessage(const MessagePtr& message, const Correlation& correlation)
+{
+    if (correlation.control != 0)
+    {
+        for (uint32_t value : { correlation.control, correlation.call_id })
+        {
+            const uint32_t network_value = htonl(value);
+            send_buffer.append(reinterpret_cast<const char*>(&network_value), sizeof(network_value));
+        }
+    }
+
+    const uint32_t header = (ARCUS_SIGNATURE << 16) | (VERSION_MAJOR << 8) | (VERSION_MINOR);
+    const uint32_t message_size = static_cast<uint32_t>(message->ByteSizeLong());
+    const uint32_t type_id = message_types->getMessageTypeId(message);
+    statistics.messageSent(type_id, message_size);
+    if (tracer)
+    {
+        // The frame is written by flushSendBuffer() together with others, so only its start is traced.
+        tracer->record(MessageTracer::Event::WriteStart, message.get(), type_id, message_size);
+    }
+
+    for (uint32_t value : { header, message_size, type_id })
+    {
+        const uint32_t network_value = htonl(value);
+        send_buffer.append(reinterpret_cast<const char*>(&network_value), sizeof(network_value));
+    }
+    message->AppendToString(&send_buffer);
+    if (capture)
+    {
+        capture->write(CapturedFrame::Direction::Sent, header, type_id, send_buffer.data() + send_buffer.size() - message_size, message_size);
+    }
+
+    DEBUG(std::string("Queued message of type ") + std::to_string(type_id) + " and size " + std::to_string(message_size));
+}
+
+// Write a control value such as a keep-alive, without interleaving it with a partially written frame.
+bool Socket::Private::writeControl(uint32_t value)
+{
+    if (! embedded)
+    {
+        return platform_socket.writeUInt32(value) != -1;
+    }
+
+    const uint32_t network_value = htonl(value);
+    send_buffer.append(reinterpret_cast<const char*>(&network_value), sizeof(network_value));
+    return flushSendBuffer();
+}
+
+// Write a control word followed by its argument.
+bool Socket::Private::writeControl(uint32_t value, uint32_t argument)
+{
+    const std::array<uint32_t, 2> words = { htonl(value), htonl(argument) };
+    if (! embedded)
+    {
+        const WriteBuffer buffer = { reinterpret_cast<const char*>(words.data()), sizeof(words) };
+        return platform_socket.writeBuffers(&buffer, 1) != -1;
+    }
+
+    send_buffer.append(reinterpret_cast<const char*>(words.data()), sizeof(words));
+    return flushSendBuffer();
+}
+
+// Write as much of the send buffer as possible without blocking.
+// Returns false if the connection failed, in which case the socket starts closing.
+bool Socket::Private::flushSendBuffer()
+{
+    while (send_buffer_offset < send_buffer.size())
+    {
+        socket_size written = platform_socket.writeBytes(send_buffer.size() - send_buffer_offset, send_buffer.data() + send_buffer_offset);
+        if (written < 0)
         {
+            if (platform_socket.wouldBlock())
+            {
+                return true;
+            }
+
             error(ErrorCode::ConnectionResetError, "Connection reset by peer");
             next_state = SocketState::Closing;
+            return false;
+        }
+
+        send_buffer_offset += static_cast<std::size_t>(written);
+        last_send_time = std::chrono::steady_clock::now();
+    }
+
+    send_buffer.clear();
+    send_buffer_offset = 0;
+
+    if (! buffered_trackers.empty())
+    {
+        reportWritten(buffered_trackers, 0, true);
+        buffered_trackers.clear();
+    }
+    return true;
+}
+
+// Determine which events an embedded socket should be woken up for.
+IoInterest Socket::Private::getIoInterest()
+{
+    switch (state)
+    {
+    case SocketState::Connecting:
+        return connect_pending ? IoInterest::Write : IoInterest::None;
+    case SocketState::Listening:
+        return IoInterest::Read;
+    case SocketState::Connected:
+    {
+        const bool reading = ! receivePaused();
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        if (send_buffer_offset < send_buffer.size() || ! sendQueue.empty())
+        {
+            return reading ? IoInterest::ReadWrite : IoInterest::Write;
+        }
+        return reading ? IoInterest::Read : IoInterest::None;
+    }
+    default:
+        return IoInterest::None;
+    }
+}
+
+// Handle receiving data until we have a proper message.
+// On the reader thread, anything that needs writing or closing the connection is left to the worker thread.
+void Socket::Private::receiveNextMessage(PlatformSocket& stream_socket, std::shared_ptr<WireMessage>& message, bool on_reader_thread)
+{
+    socket_size result = 0;
+
+    if (! message)
+    {
+        message = std::make_shared<WireMessage>();
+    }
+
+    if (message->state == WireMessage::MessageState::ControlArgument)
+    {
+        uint32_t argument = 0;
+        result = stream_socket.readUInt32(&argument);
+        if (result == 0)
+        {
+            return;
+        }
+        else if (result == -1)
+        {
+            error(ErrorCode::ReceiveFailedError, "Receiving control argument failed");
+            message.reset();
+            stream_socket.flush();
+            return;
+        }
+        last_receive_time = std::chrono::steady_clock::now();
+
+        if (message->control == SOCKET_PING && on_reader_thread)
+        {
+            // Only the worker thread writes, so it does not end up in the middle of one of its frames.
+            pong_token = argument;
+            pong_pending = true;
+            wakeWorker();
+            message.reset();
+            return;
+        }
+        else if (message->control == SOCKET_PING)
+        {
+            if (! writeControl(SOCKET_PONG, argument))
+            {
+                error(ErrorCode::ConnectionResetError, "Connection reset by peer");
+                next_state = SocketState::Closing;
+            }
+            message.reset();
+            return;
+        }
+        else if (message->control == SOCKET_PONG)
+        {
+            recordRoundTrip(argument);
+            message.reset();
+            return;
+        }
+        else if (message->control == SOCKET_SESSION)
+        {
+            peer_session_id = argument;
+            message.reset();
+            return;
+        }
+        else if (message->control == SOCKET_ACK)
+        {
+            // The first acknowledgement on a connection completes the session handshake.
+            if (session_established)
+            {
+                acknowledgeFrames(argument);
+            }
+            else if (session_resume)
+            {
+                resumeSession(peer_session_id, argument);
+            }
+            message.reset();
+            return;
+        }
+
+        if (message->control == SOCKET_SEQUENCE)
+        {
+            message->has_sequence = true;
+            message->sequence = argument;
+        }
+        else if (message->control == SOCKET_REQUEST || message->control == SOCKET_REPLY)
+        {
+            message->correlation = message->control;
+            message->call_id = argument;
         }
-        last_keep_alive_sent = now;
+        message->state = WireMessage::MessageState::Header;
+    }
+
+    if (message->state == WireMessage::MessageState::Header)
+    {
+        uint32_t header = 0;
+        if (stream_socket.readUInt32(&header) != 4)
+        {
+            // Nothing or only part of the header arrived, or the read failed.
+            return;
+        }
+        last_receive_time = std::chrono::steady_clock::now();
+
+        if (header == 0) // Keep-alive, just return
+        {
+            statistics.keepAliveReceived();
+            return;
+        }
+        else if (header == SOCKET_CLOSE)
+        {
+            // With several streams the other side closes each of them, everything has been received once all did.
+            if (++close_requests_received < extra_streams.size() + 1)
+            {
+                return;
+            }
+
+            // We received a close request from the other socket, so close this socket as well.
+            next_state = SocketState::Closing;
+            received_close = true;
+            session_finished = true;
+            return;
+        }
+        else if (header == SOCKET_PING || header == SOCKET_PONG)
+        {
+            if (header == SOCKET_PING)
+            {
+                statistics.keepAliveReceived();
+            }
+            // Round trip measurement, the token follows.
+            message->control = header;
+            message->state = WireMessage::MessageState::ControlArgument;
+            return;
+        }
+        else if (header == SOCKET_SESSION || header == SOCKET_ACK)
+        {
+            // Reliable session bookkeeping, the argument follows.
+            message->control = header;
+            message->state = WireMessage::MessageState::ControlArgument;
+            return;
+        }
+        else if (header == SOCKET_SEQUENCE)
+        {
+            // The next frame was sent over one of several streams, its sequence number follows.
+            message->control = header;
+            message->state = WireMessage::MessageState::ControlArgument;
+            return;
+        }
+        else if (header == SOCKET_REQUEST || header == SOCKET_REPLY)
+        {
+            // The next frame belongs to a call made through an RpcChannel, the call id follows.
+            message->control = header;
+            message->state = WireMessage::MessageState::ControlArgument;
+            return;
+        }
+
+        uint32_t signature = (header & 0xffff0000) >> 16;
+        uint32_t major_version = (header & 0x0000ff00) >> 8;
+        uint32_t minor_version = header & 0x000000ff;
+
+        if (signature != ARCUS_SIGNATURE)
+        {
+            // Someone might be speaking to us in a different protocol?
+            error(ErrorCode::ReceiveFailedError, "Header mismatch");
+            message.reset();
+            stream_socket.flush();
+            return;
+        }
+
+        if (major_version != VERSION_MAJOR)
+        {
+            error(ErrorCode::ReceiveFailedError, "Protocol version mismatch");
+            message.reset();
+            stream_socket.flush();
+            return;
+        }
+
+        if (minor_version != VERSION_MINOR)
+        {
+            error(ErrorCode::ReceiveFailedError, "Protocol version mismatch");
+            message.reset();
+            stream_socket.flush();
+            return;
+        }
+
+        DEBUG("Incoming message, header ok");
+        message->state = WireMessage::MessageState::Size;
+    }
+
+    if (message->state == WireMessage::MessageState::Size)
+    {
+        uint32_t size = 0;
+        result = stream_socket.readUInt32(&size);
+        if (result == 0)
+        {
+            return;
+        }
+        else if (result == -1)
+        {
+            error(ErrorCode::ReceiveFailedError, "Size invalid");
+            message.reset();
+            stream_socket.flush();
+            return;
+        }
+
+        DEBUG(std::string("Incoming message size: ") + std::to_string(size));
+        message->size = size;
+        message->state = WireMessage::MessageState::Type;
+    }
+
+    if (message->state == WireMessage::MessageState::Type)
+    {
+        uint32_t type = 0;
+        result = stream_socket.readUInt32(&type);
+        if (result == 0)
+        {
+            return;
+        }
+        else if (result == -1)
+        {
+            error(ErrorCode::ReceiveFailedError, "Receiving type failed");
+            message->valid = false;
+        }
+
+        uint32_t real_type = static_cast<uint32_t>(type);
+
+        try
+        {
+            message->allocateData();
+        }
+        catch (std::bad_alloc&)
+        {
+            // Either way we're in trouble.
+            message.reset();
+            if (on_reader_thread)
+            {
+                reader_out_of_memory = true;
+                wakeWorker();
+            }
+            else
+            {
+                fatalError(ErrorCode::ReceiveFailedError, "Out of memory");
+            }
+            return;
+        }
+
+        DEBUG(std::string("Incoming message type: ") + std::to_string(real_type));
+        message->type = real_type;
+        message->state = WireMessage::MessageState::Data;
+    }
+
+    if (message->state == WireMessage::MessageState::Data)
+    {
+        result = stream_socket.readBytes(message->getRemainingSize(), &message->data[message->received_size]);
+
+        if (result < 0)
+        {
+            error(ErrorCode::ReceiveFailedError, "Could not receive data for message");
+            message.reset();
+            return;
+        }
+        else
+        {
+            if (result > 0)
+            {
+                last_receive_time = std::chrono::steady_clock::now();
+            }
+            message->received_size = message->received_size + static_cast<uint32_t>(result);
+
+            DEBUG("Received " + std::to_string(result) + " bytes data");
+
+            if (message->isComplete())
+            {
+                if (! message->valid)
+                {
+                    message.reset();
+                    return;
+                }
+
+                message->state = WireMessage::MessageState::Dispatch;
+            }
+        }
+    }
+
+    if (message->state == WireMessage::MessageState::Dispatch)
+    {
+        handleMessage(message);
+        message.reset();
+    }
+}
+
+// Parse and process a message received on the socket.
+void Socket::Private::handleMessage(const std::shared_ptr<WireMessage>& wire_message)
+{
+    // Frames are handled as soon as their last byte arrived.
+    const int64_t frame_time = tracer ? MessageTracer::now() : 0;
+    if (capture)
+    {
+        // Captured as it arrived, also when it turns out it cannot be handled.
+        capture->write(CapturedFrame::Direction::Received, (ARCUS_SIGNATURE << 16) | (VERSION_MAJOR << 8) | (VERSION_MINOR), wire_message->type, wire_message->data, wire_message->size);
+    }
+    const bool ordered = wire_message->has_sequence && ! extra_streams.empty();
+
+    if (session_resume)
+    {
+        // Every frame counts, also the ones we fail to handle, so both sides agree on the numbering.
+        ++frames_received;
+    }
+
+    growBuffers(wire_message->size, false);
+
+    // A single lookup both checks whether the type is known and finds its prototype.
+    MessagePtr message = message_types->createMessage(wire_message->type);
+    if (! message)
+    {
+        DEBUG(std::string("Received message type: ") + std::to_string(wire_message->type));
+        error(ErrorCode::UnknownMessageTypeError, "Unknown message type " + std::to_string(wire_message->type));
+        if (ordered)
+        {
+            releaseInOrder(wire_message->sequence, ReceivedMessage());
+        }
+        return;
+    }
+
+    Correlation correlation;
+    correlation.control = wire_message->correlation;
+    correlation.call_id = wire_message->call_id;
+
+    ReceivedMessage received(message, wire_message->size);
+    if (options.defer_parsing && ! ordered && correlation.control == 0 && wire_message->size > 0 && receive_queue_length > 0)
+    {
+        // The message would only be waiting behind others, so it can as well wait unparsed.
+        deferParsing(received, *wire_message);
+    }
+    else if (! parseMessage(*message, wire_message->data, wire_message->size))
+    {
+        error(ErrorCode::ParseFailedError, "Failed to parse message:" + std::string(wire_message->data));
+        if (ordered)
+        {
+            releaseInOrder(wire_message->sequence, ReceivedMessage());
+        }
+        return;
+    }
+
+    DEBUG(std::string("Received a message of type ") + std::to_string(wire_message->type) + " and size " + std::to_string(wire_message->size));
+    statistics.messageReceived(wire_message->type, wire_message->size);
+    if (tracer)
+    {
+        tracer->record(MessageTracer::Event::FrameComplete, message.get(), wire_message->type, wire_message->size, frame_time);
+        if (received.isParsed())
+        {
+            tracer->record(MessageTracer::Event::Parsed, message.get(), 0, 0);
+        }
+    }
+
+    if (ordered && correlation.control == 0)
+    {
+        releaseInOrder(wire_message->sequence, std::move(received));
+    }
+    else if (ordered)
+    {
+        // Calls are matched by their id, so they do not need to wait for the frames before them.
+        dispatchReceivedMessage(std::move(received), correlation);
+        releaseInOrder(wire_message->sequence, ReceivedMessage());
+    }
+    else
+    {
+        dispatchReceivedMessage(std::move(received), correlation);
+    }
+}
+
+// Parse the payload of a frame into a message, recording how long it took.
+bool Socket::Private::parseMessage(google::protobuf::Message& message, const char* data, uint32_t size)
+{
+    google::protobuf::io::ArrayInputStream array(data, static_cast<int>(size));
+    google::protobuf::io::CodedInputStream stream(&array);
+    stream.SetTotalBytesLimit(message_size_maximum);
+    const auto parse_start = std::chrono::steady_clock::now();
+    const bool parsed = message.ParseFromCodedStream(&stream);
+    statistics.parse_time.record(std::chrono::steady_clock::now() - parse_start);
+    return parsed;
+}
+
+// Keep a received frame serialized until its message is taken, in the spill file if the memory limit is reached.
+void Socket::Private::deferParsing(ReceivedMessage& received, WireMessage& wire_message)
+{
+    // The buffer the frame was read into is handed over rather than copied.
+    received.data.reset(wire_message.data);
+    wire_message.data = nullptr;
+
+    bool spilled = false;
+    const std::size_t limit = options.receive_memory_limit;
+    if (limit > 0 && received.size > 0 && receive_queue_bytes - receive_queue_spilled_bytes + received.size > limit && openSpillFile())
+    {
+        const int64_t offset = spill_file->write(received.data.get(), received.size);
+        if (offset < 0)
+        {
+            error(ErrorCode::ReceiveFailedError, "Could not write to the spill file, keeping the message in memory");
+        }
+        else
+        {
+            received.spill_offset = offset;
+            received.data.reset();
+            spilled = true;
+        }
+    }
+    statistics.messageDeferred(spilled);
+}
+
+bool Socket::Private::openSpillFile()
+{
+    if (! spill_file && ! spill_failed)
+    {
+        auto file = std::make_unique<SpillFile>();
+        if (file->open(options.spill_directory))
+        {
+            spill_file = std::move(file);
+        }
+        else
+        {
+            spill_failed = true;
+            error(ErrorCode::CreationError, "Could not create a spill file, keeping received messages in memory");
+        }
+    }
+    return spill_file != nullptr;
+}
+
+// Queue messages received over several streams in the order they were sent.
+void Socket::Private::releaseInOrder(uint32_t sequence, ReceivedMessage received)
+{
+    reorder_buffer[sequence] = std::move(received);
+
+    for (auto next = reorder_buffer.find(next_receive_sequence); next != reorder_buffer.end(); next = reorder_buffer.find(next_receive_sequence))
+    {
+        ReceivedMessage ready = std::move(next->second);
+        reorder_buffer.erase(next);
+        ++next_receive_sequence;
+
+        if (ready.message)
+        {
+            queueReceivedMessage(std::move(ready));
+        }
+    }
+}
+
+// Drop the messages waiting for earlier ones, giving up their frames in the spill file.
+void Socket::Private::clearReorderBuffer()
+{
+    for (auto& waiting : reorder_buffer)
+    {
+        if (waiting.second.spill_offset >= 0)
+        {
+            spill_file->discard(waiting.second.spill_offset);
+        }
+    }
+    reorder_buffer.clear();
+}
+
+// Announce the session and how much of it we received on a new connection.
+bool Socket::Private::beginSession()
+{
+    if (session_initiator && session_id == 0)
+    {
+        std::random_device random;
+        std::uniform_int_distribution<uint32_t> distribution(1);
+        session_id = distribution(random);
+    }
+
+    session_established = false;
+    peer_session_id = 0;
+
+    const std::array<uint32_t, 4> words = { htonl(SOCKET_SESSION), htonl(session_id), htonl(SOCKET_ACK), htonl(frames_received) };
+    const WriteBuffer buffer = { reinterpret_cast<const char*>(words.data()), sizeof(words) };
+    if (platform_socket.writeBuffers(&buffer, 1) == -1)
+    {
+        return false;
+    }
+
+    frames_acknowledged = frames_received;
+    return true;
+}
+
+// Complete the session handshake once the other side announced its session.
+void Socket::Private::resumeSession(uint32_t announced_session_id, uint32_t peer_received)
+{
+    // The side that connects decides the session id. The listening side only resumes when it is
+    // offered the session it had before, and then echoes it back, which is how the connecting side knows.
+    bool resumed = announced_session_id != 0 && announced_session_id == session_id;
+    if (! session_initiator)
+    {
+        session_id = announced_session_id;
+    }
+
+    const uint32_t first_unacknowledged = frames_sent - static_cast<uint32_t>(unacknowledged.size());
+    if (resumed && peer_received - first_unacknowledged > unacknowledged.size())
+    {
+        error(ErrorCode::Debug, "The other side acknowledged frames that were never sent, starting a new session");
+        resumed = false;
+    }
+
+    if (! resumed)
+    {
+        // Whatever was not acknowledged is lost with the old session.
+        std::deque<std::pair<uint32_t, std::shared_ptr<SendTracker>>> lost;
+        lost.swap(awaiting_acknowledgement);
+        for (auto& entry : lost)
+        {
+            completeSend(entry.second);
+        }
+        unacknowledged.clear();
+        frames_sent = 0;
+        frames_received = 0;
+        frames_acknowledged = 0;
+        session_established = true;
+        return;
+    }
+
+    acknowledgeFrames(peer_received);
+    session_established = true;
+
+    if (! unacknowledged.empty())
+    {
+        error(ErrorCode::Debug, "Resuming session, sending " + std::to_string(unacknowledged.size()) + " messages again");
+        std::list<MessagePtr> messages;
+        std::vector<Correlation> frame_correlations;
+        for (const auto& frame : unacknowledged)
+        {
+            messages.push_back(frame.first);
+            frame_correlations.push_back(frame.second);
+        }
+        sendMessages(messages, frame_correlations);
+    }
+}
+
+// Keep messages that are about to be sent until they are acknowledged.
+void Socket::Private::retainForResume(const std::list<MessagePtr>& messages, const std::vector<Correlation>& frame_correlations)
+{
+    std::size_t index = 0;
+    for (const auto& message : messages)
+    {
+        unacknowledged.emplace_back(message, frame_correlations.empty() ? Correlation() : frame_correlations[index++]);
+        ++frames_sent;
+    }
+}
+
+// Forget the frames the other side confirmed it received.
+void Socket::Private::acknowledgeFrames(uint32_t peer_received)
+{
+    const uint32_t first_unacknowledged = frames_sent - static_cast<uint32_t>(unacknowledged.size());
+    const uint32_t acknowledged = peer_received - first_unacknowledged;
+    if (acknowledged > unacknowledged.size())
+    {
+        // Stale or bogus, frames are only acknowledged in order.
+        return;
+    }
+
+    unacknowledged.erase(unacknowledged.begin(), unacknowledged.begin() + acknowledged);
+    reportAcknowledged(peer_received);
+}
+
+// Tell the other side how many frames we received, either when enough arrived or when forced and anything changed.
+bool Socket::Private::sendAcknowledgement(bool force)
+{
+    const uint32_t pending = frames_received - frames_acknowledged;
+    if (pending == 0 || (! force && pending < SESSION_ACK_INTERVAL))
+    {
+        return true;
+    }
+
+    const std::array<uint32_t, 2> words = { htonl(SOCKET_ACK), htonl(frames_received) };
+    const WriteBuffer buffer = { reinterpret_cast<const char*>(words.data()), sizeof(words) };
+    if (platform_socket.writeBuffers(&buffer, 1) == -1)
+    {
+        return false;
+    }
+
+    frames_acknowledged = frames_received;
+    return true;
+}
+
+// Add a message to the send queue, tracking it if a tracker is given.
+// Returns false if the socket already stopped, in which case the tracker is not kept and has to be completed by the caller.
+bool Socket::Private::queueMessage(const MessagePtr& message, const std::shared_ptr<SendTracker>& tracker, const Correlation& correlation)
+{
+    if (tracer)
+    {
+        tracer->record(MessageTracer::Event::Queued, message.get(), message_types->getMessageTypeId(message), 0);
+    }
+    const std::size_t size = message->ByteSizeLong();
+
+    std::lock_guard<std::mutex> lock(sendQueueMutex);
+    // Checked with the lock held, since the worker fails the queued trackers with it held once the state changed.
+    const bool stopped = state == SocketState::Closed || state == SocketState::Error;
+    sendQueue.push_back(message);
+    send_queue_entries.push_back({ std::chrono::steady_clock::now(), size, stopped ? nullptr : tracker, correlation });
+    send_queue_bytes += size;
+    statistics.sendQueueDepth(sendQueue.size(), send_queue_bytes);
+    local_condition.notify_all();
+    if (sendQueue.size() == 1)
+    {
+        // The worker takes the whole queue at once, so it only needs waking up for the first message.
+        wakeWorker();
+    }
+    return ! stopped;
+}
+
+// Report that a batch of messages was written, or failed to be, given the trackers from sendQueueTaken().
+// first_frame is the session frame number of the first message, used to match acknowledgements.
+void Socket::Private::reportWritten(const std::vector<std::shared_ptr<SendTracker>>& frame_trackers, uint32_t first_frame, bool written)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<SendTracker>> completed;
+    uint32_t frame = first_frame;
+    for (const auto& tracker : frame_trackers)
+    {
+        const uint32_t message_frame = frame++;
+        if (! tracker)
+        {
+            continue;
+        }
+
+        if (written)
+        {
+            tracker->receipt.written = true;
+            tracker->receipt.written_time = now;
+        }
+
+        // A session keeps unacknowledged messages around, so even a failed write may still arrive after a resume.
+        if (tracker->completion == SendCompletion::Acknowledged && session_resume && ! local_channel)
+        {
+            awaiting_acknowledgement.emplace_back(message_frame, tracker);
+        }
+        else
+        {
+            completed.push_back(tracker);
+        }
+    }
+
+    // Only once the acknowledgements are recorded, since a resumed coroutine may well send its next message.
+    for (const auto& tracker : completed)
+    {
+        completeSend(tracker);
+    }
+}
+
+// Complete the tracked messages in the frames the other side confirmed it received.
+void Socket::Private::reportAcknowledged(uint32_t peer_received)
+{
+    const auto now = std::chrono::steady_clock::now();
+    while (! awaiting_acknowledgement.empty() && static_cast<int32_t>(peer_received - awaiting_acknowledgement.front().first) > 0)
+    {
+        std::shared_ptr<SendTracker> tracker = awaiting_acknowledgement.front().second;
+        awaiting_acknowledgement.pop_front();
+        tracker->receipt.acknowledged = true;
+        tracker->receipt.acknowledged_time = now;
+        completeSend(tracker);
+    }
+}
+
+// Complete every tracked message that did not get where it was going, unless the session may still deliver it.
+void Socket::Private::failTrackedSends(bool keep_for_resume)
+{
+    if (keep_for_resume)
+    {
+        return;
+    }
+
+    std::vector<std::shared_ptr<SendTracker>> failed;
+    for (auto& entry : awaiting_acknowledgement)
+    {
+        failed.push_back(entry.second);
+    }
+    awaiting_acknowledgement.clear();
+    failed.insert(failed.end(), buffered_trackers.begin(), buffered_trackers.end());
+    buffered_trackers.clear();
+
+    {
+        // The messages stay queued until the socket is reset, but nobody waits for them anymore.
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        for (auto& entry : send_queue_entries)
+        {
+            if (entry.tracker)
+            {
+                failed.push_back(std::move(entry.tracker));
+                entry.tracker = nullptr;
+            }
+        }
+    }
+
+    for (const auto& tracker : failed)
+    {
+        completeSend(tracker);
+    }
+}
+
+// Hand the receipt of a tracked message to whoever is waiting for it.
+void Socket::Private::completeSend(const std::shared_ptr<SendTracker>& tracker)
+{
+    if (tracker->awaiter)
+    {
+        tracker->awaiter->_receipt = tracker->receipt;
+        tracker->awaiter->_handle.resume();
+    }
+    else
+    {
+        tracker->promise.set_value(tracker->receipt);
+    }
+}
+
+// Forget everything about the session, the next connection starts a new one.
+void Socket::Private::clearSession()
+{
+    session_id = 0;
+    peer_session_id = 0;
+    session_established = false;
+    session_finished = false;
+    frames_sent = 0;
+    frames_received = 0;
+    frames_acknowledged = 0;
+    unacknowledged.clear();
+}
+
+// Resume every coroutine waiting for a message, without one, since none will arrive anymore.
+void Socket::Private::resumeReceivers()
+{
+    std::deque<ReceiveAwaitable*> waiters;
+    {
+        std::lock_guard<std::mutex> lock(receiveQueueMutex);
+        waiters.swap(receive_waiters);
+    }
+
+    for (ReceiveAwaitable* waiter : waiters)
+    {
+        waiter->_handle.resume();
+    }
+}
+
+// Make a received message available to the application.
+void Socket::Private::queueReceivedMessage(ReceivedMessage received)
+{
+    receiveQueueMutex.lock();
+    if (! receive_waiters.empty())
+    {
+        // Someone is awaiting a message, so it does not need to go through the queue.
+        ReceiveAwaitable* waiter = receive_waiters.front();
+        receive_waiters.pop_front();
+        receiveQueueMutex.unlock();
+
+        // The queue may have emptied since the parsing of this message was deferred.
+        const bool was_parsed = received.isParsed();
+        const MessagePtr message = completeReceivedMessage(received);
+        if (! message)
+        {
+            std::lock_guard<std::mutex> lock(receiveQueueMutex);
+            receive_waiters.push_front(waiter);
+            return;
+        }
+
+        // Handed over without waiting in the queue.
+        statistics.receive_queue_time.record(std::chrono::steady_clock::duration::zero());
+        if (tracer && was_parsed)
+        {
+            tracer->record(MessageTracer::Event::Taken, message.get(), 0, 0);
+        }
+        waiter->_message = message;
+        waiter->_handle.resume();
+        return;
+    }
+    received.time = std::chrono::steady_clock::now();
+    receive_queue_bytes += received.size;
+    if (received.spill_offset >= 0)
+    {
+        receive_queue_spilled_bytes += received.size;
+    }
+    receiveQueue.push_back(std::move(received));
+    receive_queue_length = receiveQueue.size();
+    statistics.receiveQueueDepth(receiveQueue.size(), receive_queue_bytes, receive_queue_spilled_bytes);
+    receiveQueueMutex.unlock();
+
+    for (auto listener : listeners)
+    {
+        listener->messageReceived();
+    }
+
+    message_received_condition_variable.notify_all();
+    notifySelectors();
+}
+
+// Hand a received message to the RPC channel if it is tagged, otherwise make it available to the application.
+void Socket::Private::dispatchReceivedMessage(ReceivedMessage received, const Correlation& correlation)
+{
+    if (correlation.control == 0)
+    {
+        queueReceivedMessage(std::move(received));
+        return;
+    }
+
+    // Tagged messages are never deferred.
+    const MessagePtr& message = received.message;
+
+    std::lock_guard<std::mutex> lock(rpc_channel_mutex);
+    if (rpc_channel)
+    {
+        rpc_channel->messageReceived(correlation.control == SOCKET_REPLY, correlation.call_id, message);
+    }
+    else
+    {
+        error(ErrorCode::Debug, "Dropping a call without an RPC channel to handle it");
+    }
+}
+
+// Exchange messages with a peer in the same process.
+void Socket::Private::processLocal()
+{
+    std::list<MessagePtr> outgoing;
+    std::vector<std::shared_ptr<SendTracker>> frame_trackers;
+    std::vector<Correlation> frame_correlations;
+    std::deque<std::pair<MessagePtr, Correlation>> incoming;
+    {
+        std::unique_lock<std::mutex> lock(sendQueueMutex);
+        local_condition.wait_for(lock, std::chrono::milliseconds(250), [&]() { return ! sendQueue.empty() || ! local_inbox.empty() || next_state != state; });
+
+        outgoing.assign(sendQueue.begin(), sendQueue.end());
+        sendQueue.clear();
+        sendQueueTaken(outgoing.size(), true, frame_trackers, &frame_correlations);
+        incoming.swap(local_inbox);
+    }
+
+    for (const auto& message : incoming)
+    {
+        const uint32_t type_id = message_types->getMessageTypeId(message.first);
+        statistics.messageReceived(type_id, 0);
+        if (tracer)
+        {
+            // Nothing to parse, but this keeps the stages the same as for network connections.
+            const int64_t time = MessageTracer::now();
+            tracer->record(MessageTracer::Event::FrameComplete, message.first.get(), type_id, 0, time);
+            tracer->record(MessageTracer::Event::Parsed, message.first.get(), 0, 0, time);
+        }
+        if (capture)
+        {
+            const std::string payload = message.first->SerializeAsString();
+            capture->write(CapturedFrame::Direction::Received, (ARCUS_SIGNATURE << 16) | (VERSION_MAJOR << 8) | (VERSION_MINOR), type_id, payload.data(), payload.size());
+        }
+        dispatchReceivedMessage(message.first, message.second);
+    }
+
+    if (outgoing.empty())
+    {
+        return;
+    }
+
+    const bool delivered = deliverLocal(outgoing, frame_correlations);
+    reportWritten(frame_trackers, 0, delivered);
+    if (! delivered)
+    {
+        error(ErrorCode::ConnectionResetError, "Connection reset by peer");
+        next_state = SocketState::Closing;
+    }
+}
+
+// Hand messages to the peer in the same process.
+// Returns false if the peer is gone.
+bool Socket::Private::deliverLocal(std::list<MessagePtr>& messages, const std::vector<Correlation>& frame_correlations)
+{
+    std::lock_guard<std::mutex> lock(local_channel->mutex);
+    Private* peer = local_channel->ends[0] == this ? local_channel->ends[1] : local_channel->ends[0];
+    if (! peer)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> peer_lock(peer->sendQueueMutex);
+        std::size_t index = 0;
+        for (const auto& message : messages)
+        {
+            const Correlation correlation = frame_correlations.empty() ? Correlation() : frame_correlations[index++];
+            const uint32_t type_id = message_types->getMessageTypeId(message);
+            statistics.messageSent(type_id, 0);
+            if (tracer)
+            {
+                tracer->record(MessageTracer::Event::WriteStart, message.get(), type_id, 0);
+            }
+            if (capture)
+            {
+                // In-process connections do not serialize, so the frame is only made up for the capture.
+                const std::string payload = message->SerializeAsString();
+                capture->write(CapturedFrame::Direction::Sent, (ARCUS_SIGNATURE << 16) | (VERSION_MAJOR << 8) | (VERSION_MINOR), type_id, payload.data(), payload.size());
+            }
+            if (local_channel->copy_messages)
+            {
+                MessagePtr copy(message->New());
+                copy->CopyFrom(*message);
+                peer->local_inbox.emplace_back(copy, correlation);
+            }
+            else
+            {
+                peer->local_inbox.emplace_back(message, correlation);
+            }
+        }
+    }
+
+    peer->local_condition.notify_all();
+    if (tracer)
+    {
+        for (const auto& message : messages)
+        {
+            tracer->record(MessageTracer::Event::WriteEnd, message.get(), 0, 0);
+        }
+    }
+    return true;
+}
+
+// Close an in-process connection, telling the peer to close as well if we initiated it.
+void Socket::Private::closeLocal()
+{
+    if (! received_close)
+    {
+        // Flush the send queue so the peer gets everything we sent before closing.
+        std::list<MessagePtr> outgoing;
+        std::vector<std::shared_ptr<SendTracker>> frame_trackers;
+        std::vector<Correlation> frame_correlations;
+        {
+            std::lock_guard<std::mutex> lock(sendQueueMutex);
+            outgoing.assign(sendQueue.begin(), sendQueue.end());
+            sendQueue.clear();
+            sendQueueTaken(outgoing.size(), true, frame_trackers, &frame_correlations);
+        }
+        if (! outgoing.empty())
+        {
+            reportWritten(frame_trackers, 0, deliverLocal(outgoing, frame_correlations));
+        }
+    }
+    else
+    {
+        // The peer requested a close. Everything it sent before that is in the inbox,
+        // while everything we still wanted to send would not be processed anyway.
+        std::deque<std::pair<MessagePtr, Correlation>> incoming;
+        std::vector<std::shared_ptr<SendTracker>> dropped_trackers;
+        {
+            std::lock_guard<std::mutex> lock(sendQueueMutex);
+            incoming.swap(local_inbox);
+            sendQueue.clear();
+            sendQueueTaken(send_queue_entries.size(), false, dropped_trackers);
+        }
+        reportWritten(dropped_trackers, 0, false);
+        for (const auto& message : incoming)
+        {
+            dispatchReceivedMessage(message.first, message.second);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(local_channel->mutex);
+        Private* peer = local_channel->ends[0] == this ? local_channel->ends[1] : local_channel->ends[0];
+        if (peer && ! received_close)
+        {
+            peer->received_close = true;
+            peer->next_state = SocketState::Closing;
+            peer->local_condition.notify_all();
+        }
+
+        local_channel->ends[local_channel->ends[0] == this ? 0 : 1] = nullptr;
+    }
+
+    local_channel.reset();
+    next_state = SocketState::Closed;
+}
+
+// Probe an idle connection to check whether we are still connected, and give up on a peer that went silent.
+void Socket::Private::checkConnectionState()
+{
+    const auto now = std::chrono::steady_clock::now();
+    const auto interval = std::chrono::milliseconds(options.keep_alive_interval);
+
+    // A live peer sends at least its own keep-alives, so silence for this long means it hangs or is gone.
+    if (options.dead_peer_timeout > 0 && ! receive_paused && now - last_receive_time.load() > std::chrono::milliseconds(options.dead_peer_timeout))
+    {
+        fatalError(ErrorCode::ConnectionResetError, "The other side did not respond in time");
+        return;
+    }
+
+    // Data we sent recently already proves the connection works, so only probe when it is idle.
+    // Round trip samples are also taken while busy, but much less often.
+    std::unique_lock<std::mutex> lock(round_trip_mutex);
+    const bool idle = now - last_send_time.load() > interval;
+    const bool sample_due = options.measure_round_trip_time && now - last_round_trip_sample > interval * 4 && (! ping_outstanding || now - ping_sent_time > interval * 4);
+    if (! idle && ! sample_due)
+    {
+        return;
+    }
+
+    bool written = true;
+    if (options.measure_round_trip_time && (! ping_outstanding || now - ping_sent_time > interval * 4))
+    {
+        // A ping that never got an answer is simply replaced.
+        ping_outstanding = true;
+        ++ping_token;
+        ping_sent_time = now;
+        const uint32_t token = ping_token;
+        lock.unlock();
+        written = writeControl(SOCKET_PING, token);
+    }
+    else
+    {
+        constexpr uint32_t keepalive = 0;
+        written = writeControl(keepalive);
+    }
+    statistics.keepAliveSent();
+
+    for (auto& stream : extra_streams)
+    {
+        if (! written)
+        {
+            break;
+        }
+        written = stream->socket.writeUInt32(0) != -1;
+    }
+
+    if (written && session_resume && session_established)
+    {
+        written = sendAcknowledgement(true);
+    }
+
+    if (! written)
+    {
+        error(ErrorCode::ConnectionResetError, "Connection reset by peer");
+        next_state = SocketState::Closing;
+    }
+    last_send_time = now;
+}
+
+// Update the smoothed round trip time with the answer to our ping, in the same way TCP does (RFC 6298).
+void Socket::Private::recordRoundTrip(uint32_t token)
+{
+    std::lock_guard<std::mutex> lock(round_trip_mutex);
+    if (! ping_outstanding || token != ping_token)
+    {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const int64_t sample = std::chrono::duration_cast<std::chrono::microseconds>(now - ping_sent_time).count();
+    const int64_t smoothed = smoothed_round_trip_time;
+    smoothed_round_trip_time = smoothed == 0 ? std::max<int64_t>(sample, 1) : smoothed + (sample - smoothed) / 8;
+
+    ping_outstanding = false;
+    last_round_trip_sample = now;
+}
+
+// Wake up any selector waiting on this socket.
+void Socket::Private::notifySelectors()
+{
+    ++event_serial;
+
+    std::lock_guard<std::mutex> lock(selectors_mutex);
+    for (auto selector : selectors)
+    {
+        selector->wakeUp();
+    }
+}
+
+// Check whether there are messages waiting to be taken.
+bool Socket::Private::hasPendingMessages()
+{
+    std::lock_guard<std::mutex> lock(receiveQueueMutex);
+    return ! receiveQueue.empty();
+}
+
+void Socket::Private::sendQueueTaken(std::size_t count, bool sent, std::vector<std::shared_ptr<SendTracker>>& frame_trackers, std::vector<Correlation>* frame_correlations)
+{
+    const auto now = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count && ! send_queue_entries.empty(); ++i)
+    {
+        QueueEntry& entry = send_queue_entries.front();
+        if (sent)
+        {
+            statistics.send_queue_time.record(now - entry.time);
+        }
+        if (entry.tracker)
+        {
+            frame_trackers.resize(count);
+            frame_trackers[i] = std::move(entry.tracker);
+        }
+        if (frame_correlations && entry.correlation.control != 0)
+        {
+            frame_correlations->resize(count);
+            (*frame_correlations)[i] = entry.correlation;
+        }
+        send_queue_bytes -= entry.size;
+        send_queue_entries.pop_front();
+    }
+    statistics.sendQueueDepth(sendQueue.size(), send_queue_bytes);
+}
+
+// Take the message at the front of receiveQueue, if any. Call with receiveQueueMutex locked.
+bool Socket::Private::popReceivedMessage(ReceivedMessage& received)
+{
+    if (receiveQueue.empty())
+    {
+        return false;
+    }
+
+    received = std::move(receiveQueue.front());
+    receiveQueue.pop_front();
+
+    statistics.receive_queue_time.record(std::chrono::steady_clock::now() - received.time);
+    receive_queue_bytes -= received.size;
+    if (received.spill_offset >= 0)
+    {
+        receive_queue_spilled_bytes -= received.size;
+    }
+    receive_queue_length = receiveQueue.size();
+    statistics.receiveQueueDepth(receiveQueue.size(), receive_queue_bytes, receive_queue_spilled_bytes);
+    if (receive_paused && receive_queue_bytes <= receiveLowWaterMark())
+    {
+        wakeReceiving();
+        wakeWorker();
+    }
+
+    if (tracer && received.isParsed())
+    {
+        tracer->record(MessageTracer::Event::Taken, received.message.get(), 0, 0);
+    }
+    return true;
+}
+
+// Parse a message taken from the receive queue if its parsing was deferred, returns nullptr if that fails.
+MessagePtr Socket::Private::completeReceivedMessage(ReceivedMessage& received)
+{
+    if (received.isParsed())
+    {
+        return received.message;
+    }
+
+    if (received.spill_offset >= 0)
+    {
+        received.data = spill_file->read(received.spill_offset, received.size);
+        received.spill_offset = -1;
+        if (! received.data)
+        {
+            error(ErrorCode::ReceiveFailedError, "Could not read a message back from the spill file");
+            return MessagePtr();
+        }
+    }
+
+    const bool parsed = parseMessage(*received.message, received.data.get(), received.size);
+    received.data.reset();
+    if (! parsed)
+    {
+        error(ErrorCode::ParseFailedError, "Failed to parse message of type " + std::to_string(message_types->getMessageTypeId(received.message)));
+        return MessagePtr();
+    }
+
+    if (tracer)
+    {
+        // Deferred messages are parsed as they are taken.
+        tracer->record(MessageTracer::Event::Parsed, received.message.get(), 0, 0);
+        tracer->record(MessageTracer::Event::Taken, received.message.get(), 0, 0);
+    }
+    return received.message;
+}
+
+// Take the next message that can be parsed from the receive queue, or nullptr if there is none.
+MessagePtr Socket::Private::takeReceivedMessage()
+{
+    for (;;)
+    {
+        ReceivedMessage received;
+        {
+            std::lock_guard<std::mutex> lock(receiveQueueMutex);
+            if (! popReceivedMessage(received))
+            {
+                return MessagePtr();
+            }
+        }
+
+        // Parsed outside of the lock, so the worker can keep queueing meanwhile.
+        MessagePtr message = completeReceivedMessage(received);
+        if (message)
+        {
+            return message;
+        }
+    }
+}
+
+// Stop or resume reading the connection depending on how full the receive queue is, see SocketOptions::receive_high_water_mark.
+bool Socket::Private::receivePaused()
+{
+    const std::size_t high_water_mark = options.receive_high_water_mark;
+    if (high_water_mark == 0)
+    {
+        return false;
+    }
+
+    if (! receive_paused && receive_queue_bytes >= high_water_mark)
+    {
+        receive_paused = true;
+        statistics.receivePaused();
+        DEBUG("The receive queue reached its high-water mark, pausing reading");
+    }
+    else if (receive_paused && receive_queue_bytes <= receiveLowWaterMark())
+    {
+        receive_paused = false;
+        // The silence while paused was our doing, not the other side's.
+        last_receive_time = std::chrono::steady_clock::now();
+        DEBUG("The receive queue drained to its low-water mark, resuming reading");
+    }
+    return receive_paused;
+}
+
+std::size_t Socket::Private::receiveLowWaterMark() const
+{
+    const std::size_t high_water_mark = options.receive_high_water_mark;
+    return options.receive_low_water_mark > 0 ? std::min(options.receive_low_water_mark, high_water_mark) : high_water_mark / 2;
+}
+
+// Wake up the reader thread if it waits for the receive queue to drain.
+void Socket::Private::wakeReceiving()
+{
+    {
+        // Taking the lock makes sure the reader thread is either waiting already or yet to check the queue.
+        std::lock_guard<std::mutex> lock(receive_resume_mutex);
+    }
+    receive_resume_condition.notify_all();
+}
+
+void Socket::Private::reportStatistics()
+{
+    const auto interval = statistics_interval.load();
+    const auto now = std::chrono::steady_clock::now();
+    if (interval.count() <= 0 || now - last_statistics_report < interval)
+    {
+        return;
+    }
+    last_statistics_report = now;
+
+    const SocketStatistics snapshot = statistics.snapshot();
+    for (auto listener : listeners)
+    {
+        listener->statisticsUpdated(snapshot);
     }
 }
 } // namespace Arcus
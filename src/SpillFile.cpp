@@ -0,0 +1,165 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include "SpillFile_p.h"
+
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <system_error>
+
+using namespace Arcus::Private;
+
+namespace
+{
+// Once the segment being written to is this large, the next frame goes into a new one.
+constexpr int64_t segment_size = 16 * 1024 * 1024;
+
+void removeSegmentFile(std::fstream& file, const std::string& file_name)
+{
+    file.close();
+    std::error_code ignored;
+    std::filesystem::remove(file_name, ignored);
+}
+} // namespace
+
+SpillFile::~SpillFile()
+{
+    for (auto& segment : segments)
+    {
+        removeSegmentFile(segment->file, segment->file_name);
+    }
+}
+
+bool SpillFile::open(const std::string& directory_name)
+{
+    std::error_code error;
+    const std::filesystem::path base = directory_name.empty() ? std::filesystem::temp_directory_path(error) : std::filesystem::path(directory_name);
+    if (error)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    directory = base;
+    return addSegment();
+}
+
+int64_t SpillFile::write(const char* data, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Segment* segment = segments.back().get();
+    if (segment->outstanding > 0 && segment->end - segment->start + static_cast<int64_t>(size) > segment_size)
+    {
+        if (! addSegment())
+        {
+            return -1;
+        }
+        segment = segments.back().get();
+    }
+
+    segment->file.clear();
+    segment->file.seekp(segment->end - segment->start);
+    segment->file.write(data, static_cast<std::streamsize>(size));
+    if (! segment->file)
+    {
+        return -1;
+    }
+
+    const int64_t offset = end;
+    end += static_cast<int64_t>(size);
+    segment->end = end;
+    ++segment->outstanding;
+    return offset;
+}
+
+std::unique_ptr<char[]> SpillFile::read(int64_t offset, std::size_t size)
+{
+    std::unique_ptr<char[]> data(new char[size]);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto segment = findSegment(offset);
+    if (segment == segments.end())
+    {
+        return nullptr;
+    }
+
+    Segment& found = **segment;
+    found.file.clear();
+    found.file.seekg(offset - found.start);
+    found.file.read(data.get(), static_cast<std::streamsize>(size));
+    const bool complete = static_cast<bool>(found.file);
+    release(segment);
+    if (! complete)
+    {
+        return nullptr;
+    }
+    return data;
+}
+
+void SpillFile::discard(int64_t offset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto segment = findSegment(offset);
+    if (segment != segments.end())
+    {
+        release(segment);
+    }
+}
+
+// Start writing to a new segment file. Needs the mutex to be locked.
+bool SpillFile::addSegment()
+{
+    static std::atomic<unsigned> counter(0);
+
+    // Several sockets and processes may spill at the same time, so the name has to be unique.
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    const std::string name = "arcus-spill-" + std::to_string(stamp) + "-" + std::to_string(counter++) + ".tmp";
+
+    auto segment = std::make_unique<Segment>();
+    segment->file_name = (directory / name).string();
+    segment->file.open(segment->file_name, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (! segment->file.is_open())
+    {
+        return false;
+    }
+    segment->start = end;
+    segment->end = end;
+    segments.push_back(std::move(segment));
+    return true;
+}
+
+// Find the segment holding the frame at an offset. Needs the mutex to be locked.
+std::deque<std::unique_ptr<SpillFile::Segment>>::iterator SpillFile::findSegment(int64_t offset)
+{
+    for (auto segment = segments.begin(); segment != segments.end(); ++segment)
+    {
+        if (offset >= (*segment)->start && offset < (*segment)->end && (*segment)->outstanding > 0)
+        {
+            return segment;
+        }
+    }
+    return segments.end();
+}
+
+// Account for a frame that is gone. Needs the mutex to be locked.
+void SpillFile::release(std::deque<std::unique_ptr<Segment>>::iterator segment)
+{
+    Segment& found = **segment;
+    if (--found.outstanding > 0)
+    {
+        return;
+    }
+
+    if (std::next(segment) == segments.end())
+    {
+        // Keep the segment that is written to, but start over from its beginning.
+        found.start = end;
+        found.end = end;
+    }
+    else
+    {
+        removeSegmentFile(found.file, found.file_name);
+        segments.erase(segment);
+    }
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_SPILL_FILE_P_H
+#define ARCUS_SPILL_FILE_P_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Arcus
+{
+namespace Private
+{
+/**
+ * Temporary files holding received frames until they are taken.
+ *
+ * Frames are appended and read back or discarded in any order, each exactly once.
+ * They are written to a series of segment files. A segment is removed once all its
+ * frames are gone, and the segment being written to starts over from the beginning.
+ * So disk use follows the frames still waiting instead of growing for as long as
+ * any frame is. The files are removed when this is destroyed. Safe to use from
+ * several threads.
+ */
+class SpillFile
+{
+public:
+    ~SpillFile();
+
+    /**
+     * Create the first file.
+     *
+     * \param directory_name The directory to create the files in, or empty for the temporary directory of the system.
+     *
+     * \return false if the file could not be created.
+     */
+    bool open(const std::string& directory_name);
+
+    /**
+     * Store a frame.
+     *
+     * \return The offset to read the frame back from, or -1 if it could not be written.
+     */
+    int64_t write(const char* data, std::size_t size);
+
+    /**
+     * Read back a frame that was written earlier.
+     *
+     * \return The data of the frame, or nullptr if it could not be read.
+     */
+    std::unique_ptr<char[]> read(int64_t offset, std::size_t size);
+
+    /**
+     * Give up a frame that was written earlier without reading it back.
+     */
+    void discard(int64_t offset);
+
+private:
+    // One of the files. Frames in it take the offsets from start to end.
+    struct Segment
+    {
+        std::fstream file;
+        std::string file_name;
+        int64_t start = 0;
+        int64_t end = 0;
+        // Frames written but not read back or discarded yet.
+        std::size_t outstanding = 0;
+    };
+
+    bool addSegment();
+    std::deque<std::unique_ptr<Segment>>::iterator findSegment(int64_t offset);
+    void release(std::deque<std::unique_ptr<Segment>>::iterator segment);
+
+    std::mutex mutex;
+    std::filesystem::path directory;
+    // Oldest first, frames are written to the last one.
+    std::deque<std::unique_ptr<Segment>> segments;
+    // The offset of the next frame. Offsets keep increasing, so they identify a frame across segments.
+    int64_t end = 0;
+};
+} // namespace Private
+} // namespace Arcus
+
+#endif // ARCUS_SPILL_FILE_P_H
@@ -22,13 +22,14 @@ public:
     enum class MessageState
     {
         Header, ///< Check for the header.
+        ControlArgument, ///< Get the argument of a control word that preceded the header.
         Size, ///< Check for the message size.
         Type, ///< Check for the message type.
         Data, ///< Get the message data.
         Dispatch ///< Process the message and parse it into a protobuf message.
     };
 
-    WireMessage() : state(MessageState::Header), size(0), received_size(0), valid(true), type(0), data(nullptr)
+    WireMessage() : state(MessageState::Header), size(0), received_size(0), valid(true), type(0), data(nullptr), control(0), has_sequence(false), sequence(0), correlation(0), call_id(0)
     {
     }
 
@@ -52,6 +53,16 @@ public:
     uint32_t type;
     // The data of the message.
     char* data;
+    // The control word whose argument is being read.
+    uint32_t control;
+    // Does this message carry a sequence number, because it was sent over one of several streams?
+    bool has_sequence;
+    // The sequence number of the message.
+    uint32_t sequence;
+    // SOCKET_REQUEST or SOCKET_REPLY if the message belongs to a call, 0 otherwise.
+    uint32_t correlation;
+    // The id of the call the message belongs to.
+    uint32_t call_id;
 
     // Return how many bytes are remaining for this message to be complete.
     inline uint32_t getRemainingSize() const
@@ -1,4 +1,5 @@
 #include <Arcus/Error.h>
+#include <Arcus/MessageTypeStore.h>
 #include <Arcus/Socket.h>
 #include <Arcus/SocketListener.h>
 #include <chrono>
@@ -6,6 +7,7 @@
 #include <thread>
 
 #include "test.h"
+#include "test_descriptor_set.h"
 
 constexpr int sleep_msec{ 500 };
 constexpr uint16_t port{ 44444 };
@@ -76,6 +78,19 @@ Arcus::Socket* connectSend()
     return socket;
 }
 
+bool registerDescriptorSet()
+{
+    Arcus::MessageTypeStore store;
+    if (! store.registerAllMessageTypesFromDescriptorSet(test_descriptor_set, test_descriptor_set_size))
+    {
+        std::cerr << store.getErrorMessages() << std::endl;
+        return false;
+    }
+
+    // Only the types of the file the set was made for, not those of the files it imports.
+    return store.hasType("test.proto.ProgressReport") && ! store.hasType("test.proto.Progress");
+}
+
 void receive()
 {
     std::cerr << "Start reviever." << std::endl;
@@ -91,6 +106,12 @@ int main(int argc, char** argv)
     std::cerr << "Tests For Arcus -- debug\n";
 #endif
 
+    if (! registerDescriptorSet())
+    {
+        std::cerr << "Failed to register the embedded descriptor set." << std::endl;
+        return 3;
+    }
+
     // Start thread to receive.
     receive();
 
@@ -0,0 +1,138 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/Socket.h"
+#include "TestUtils.h"
+
+using namespace Arcus;
+
+namespace
+{
+/**
+ * A coroutine that starts right away and cleans up after itself.
+ */
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object()
+        {
+            return Detached();
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+Detached receiveOne(Socket* socket, std::promise<MessagePtr>* result)
+{
+    result->set_value(co_await socket->receive());
+}
+
+Detached sendOne(Socket* socket, int number, std::promise<SendReceipt>* result)
+{
+    result->set_value(co_await socket->send(makeNumbered(number)));
+}
+
+Detached sendAndCount(Socket* socket, int number, std::atomic<int>* completed)
+{
+    co_await socket->send(makeNumbered(number));
+    ++(*completed);
+}
+
+// Closes the socket from the worker thread that resumes it.
+Detached receiveAndClose(Socket* socket, std::promise<MessagePtr>* result)
+{
+    MessagePtr message = co_await socket->receive();
+    socket->close();
+    result->set_value(message);
+}
+
+using AwaitableTest = SocketPairTest;
+} // namespace
+
+TEST_F(AwaitableTest, ReceiveEndsWhenTheSocketCloses)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    std::promise<MessagePtr> received;
+    receiveOne(&server, &received);
+
+    std::future<MessagePtr> result = received.get_future();
+    EXPECT_EQ(result.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+    client.close();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(result.get(), nullptr);
+}
+
+TEST_F(AwaitableTest, SendAfterCloseDoesNotSuspend)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    client.close();
+
+    std::promise<SendReceipt> sent;
+    sendOne(&client, 1, &sent);
+    std::future<SendReceipt> result = sent.get_future();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_FALSE(result.get().written);
+}
+
+// Whether a send comes before or after the close, its coroutine is resumed.
+TEST_F(AwaitableTest, SendsDuringCloseAreAllResumed)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+
+    constexpr int send_count = 5000;
+    std::atomic<int> completed(0);
+    std::thread sender(
+        [this, &completed]()
+        {
+            for (int i = 0; i < send_count; ++i)
+            {
+                sendAndCount(&client, i, &completed);
+            }
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    client.close();
+    sender.join();
+
+    EXPECT_TRUE(waitFor([&completed]() { return completed == send_count; }));
+}
+
+TEST_F(AwaitableTest, ResumedCoroutineMayClose)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    std::promise<MessagePtr> received;
+    receiveAndClose(&server, &received);
+
+    ASSERT_TRUE(client.sendMessage(makeNumbered(1)));
+    std::future<MessagePtr> result = received.get_future();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_NE(result.get(), nullptr);
+    EXPECT_TRUE(waitForState(server, SocketState::Closed));
+}
@@ -0,0 +1,196 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/Socket.h"
+#include "Arcus/SocketOptions.h"
+#include "TestUtils.h"
+
+using namespace Arcus;
+
+namespace
+{
+constexpr std::size_t high_water_mark = 16 * 1024;
+constexpr std::size_t low_water_mark = 4 * 1024;
+constexpr std::size_t payload_size = 1024;
+constexpr int message_count = 2000;
+
+class ReceiveFlowControlTest : public SocketPairTest
+{
+protected:
+    void SetUp() override
+    {
+        // Small kernel buffers, so the sender notices soon when the receiver stops reading.
+        SocketOptions server_options;
+        server_options.receive_buffer_size = 64 * 1024;
+        server_options.receive_high_water_mark = high_water_mark;
+        server_options.receive_low_water_mark = low_water_mark;
+        server.setOptions(server_options);
+
+        SocketOptions client_options;
+        client_options.send_buffer_size = 64 * 1024;
+        client.setOptions(client_options);
+
+        SocketPairTest::SetUp();
+    }
+
+    void sendAll()
+    {
+        for (int i = 0; i < message_count; ++i)
+        {
+            ASSERT_TRUE(client.sendMessage(makeNumbered(i, payload_size)));
+        }
+    }
+
+    // Wait until reading stopped and the queue no longer changes.
+    bool waitUntilPaused()
+    {
+        if (! waitFor([this]() { return server.getStatistics().receive_pauses > 0; }))
+        {
+            return false;
+        }
+        waitForSettledQueue();
+        return true;
+    }
+
+    // Wait until the queue did not change for a while, so whatever the socket was reading has arrived.
+    void waitForSettledQueue()
+    {
+        std::size_t bytes = server.getStatistics().receive_queue_bytes;
+        for (int stable = 0; stable < 10; ++stable)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            const std::size_t current = server.getStatistics().receive_queue_bytes;
+            if (current != bytes)
+            {
+                bytes = current;
+                stable = 0;
+            }
+        }
+    }
+
+    // The frame that crosses the high-water mark is still queued.
+    static constexpr std::size_t most_queued = high_water_mark + payload_size + 64;
+};
+} // namespace
+
+TEST_F(ReceiveFlowControlTest, ReadingStopsAtTheHighWaterMark)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    sendAll();
+    ASSERT_TRUE(waitUntilPaused());
+
+    const SocketStatistics statistics = server.getStatistics();
+    EXPECT_GE(statistics.receive_queue_bytes, high_water_mark);
+    EXPECT_LE(statistics.receive_queue_bytes, most_queued);
+    // TCP flow control holds the rest back at the sender.
+    EXPECT_LT(statistics.messages_received, static_cast<uint64_t>(message_count));
+
+    // Nothing is lost or reordered by stopping and resuming.
+    for (int i = 0; i < message_count; ++i)
+    {
+        auto message = takeNumbered(server);
+        ASSERT_NE(message, nullptr) << "Message " << i << " did not arrive";
+        ASSERT_EQ(message->number(), i);
+    }
+    EXPECT_LE(server.getStatistics().receive_queue_bytes_peak, most_queued);
+}
+
+// Between the marks the queue only drains, so reading does not stop and start for every message taken.
+TEST_F(ReceiveFlowControlTest, ReadingResumesAtTheLowWaterMark)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    sendAll();
+    ASSERT_TRUE(waitUntilPaused());
+
+    int taken = 0;
+    std::size_t bytes = server.getStatistics().receive_queue_bytes;
+    while (bytes > low_water_mark + payload_size)
+    {
+        ASSERT_NE(takeNumbered(server), nullptr);
+        ++taken;
+        waitForSettledQueue();
+        const std::size_t current = server.getStatistics().receive_queue_bytes;
+        ASSERT_LT(current, bytes) << "Reading resumed above the low-water mark";
+        bytes = current;
+    }
+
+    // Going below the low-water mark makes the socket read again.
+    while (bytes > low_water_mark)
+    {
+        ASSERT_NE(takeNumbered(server), nullptr);
+        ++taken;
+        bytes = server.getStatistics().receive_queue_bytes;
+    }
+    EXPECT_TRUE(waitFor([this]() { return server.getStatistics().receive_queue_bytes > high_water_mark; }));
+    EXPECT_GE(server.getStatistics().receive_pauses, 2u);
+
+    for (int i = taken; i < message_count; ++i)
+    {
+        auto message = takeNumbered(server);
+        ASSERT_NE(message, nullptr);
+        ASSERT_EQ(message->number(), i);
+    }
+}
+
+// An embedded socket stops asking for read events instead of blocking the caller's event loop.
+TEST_F(ReceiveFlowControlTest, EmbeddedSocketStopsAskingToRead)
+{
+    server.setEmbedded(true);
+    const uint16_t port = nextTestPort();
+    server.listen("127.0.0.1", port);
+    ASSERT_TRUE(waitFor(
+        [this]()
+        {
+            server.process();
+            return server.getState() != SocketState::Opening;
+        }));
+    ASSERT_EQ(server.getState(), SocketState::Listening);
+    client.connect("127.0.0.1", port);
+    ASSERT_TRUE(waitFor(
+        [this]()
+        {
+            server.process();
+            return server.getState() == SocketState::Connected;
+        }));
+
+    sendAll();
+    ASSERT_TRUE(waitFor(
+        [this]()
+        {
+            server.process();
+            return server.getStatistics().receive_pauses > 0;
+        }));
+    server.process();
+    const IoInterest paused_interest = server.getIoInterest();
+    EXPECT_TRUE(paused_interest == IoInterest::None || paused_interest == IoInterest::Write);
+    EXPECT_LE(server.getStatistics().receive_queue_bytes, most_queued);
+
+    for (int i = 0; i < message_count; ++i)
+    {
+        Arcus::MessagePtr taken;
+        ASSERT_TRUE(waitFor(
+            [this, &taken]()
+            {
+                taken = server.tryTakeNextMessage();
+                if (! taken)
+                {
+                    server.process();
+                }
+                return taken != nullptr;
+            }));
+        auto message = std::dynamic_pointer_cast<arcus::test::Numbered>(taken);
+        ASSERT_NE(message, nullptr);
+        ASSERT_EQ(message->number(), i);
+    }
+    const IoInterest drained_interest = server.getIoInterest();
+    EXPECT_TRUE(drained_interest == IoInterest::Read || drained_interest == IoInterest::ReadWrite);
+
+    // Nothing processes the close handshake of the client for an embedded server, so close this side first.
+    server.close();
+}
@@ -0,0 +1,163 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/RpcChannel.h"
+#include "Arcus/Socket.h"
+#include "TestUtils.h"
+
+using namespace Arcus;
+
+namespace
+{
+class RpcChannelTest : public SocketPairTest
+{
+protected:
+    void SetUp() override
+    {
+        SocketPairTest::SetUp();
+        ASSERT_TRUE(connectSockets(server, client));
+    }
+
+    RpcChannel server_channel { server };
+    RpcChannel client_channel { client };
+};
+
+int replyNumber(const CallResult& result)
+{
+    auto reply = std::dynamic_pointer_cast<arcus::test::Numbered>(result.reply);
+    return reply ? reply->number() : -1;
+}
+} // namespace
+
+// Replies go out in the opposite order of the requests, each still has to reach its own call.
+TEST_F(RpcChannelTest, ConcurrentCallsGetTheirOwnReplies)
+{
+    constexpr int call_count = 20;
+    std::mutex mutex;
+    std::vector<std::pair<uint32_t, int>> requests;
+    server_channel.setRequestHandler(
+        [&](uint32_t call_id, const MessagePtr& request)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.emplace_back(call_id, std::static_pointer_cast<arcus::test::Numbered>(request)->number());
+            if (requests.size() < call_count)
+            {
+                return;
+            }
+            for (auto answered = requests.rbegin(); answered != requests.rend(); ++answered)
+            {
+                server_channel.reply(answered->first, makeNumbered(answered->second * 2));
+            }
+        });
+
+    std::vector<RpcChannel::Call> calls;
+    for (int i = 0; i < call_count; ++i)
+    {
+        calls.push_back(client_channel.call(makeNumbered(i), std::chrono::milliseconds(10000)));
+    }
+
+    for (int i = 0; i < call_count; ++i)
+    {
+        const CallResult result = calls[static_cast<std::size_t>(i)].result.get();
+        ASSERT_EQ(result.status, CallStatus::Replied);
+        EXPECT_EQ(replyNumber(result), i * 2);
+    }
+    EXPECT_EQ(client_channel.getPendingCallCount(), 0u);
+}
+
+TEST_F(RpcChannelTest, CallsAndPlainMessagesDoNotMix)
+{
+    server_channel.setRequestHandler([this](uint32_t call_id, const MessagePtr&) { server_channel.reply(call_id, makeNumbered(-1)); });
+
+    ASSERT_TRUE(client.sendMessage(makeNumbered(1)));
+    RpcChannel::Call call = client_channel.call(makeNumbered(2), std::chrono::milliseconds(10000));
+    ASSERT_TRUE(client.sendMessage(makeNumbered(3)));
+
+    const CallResult result = call.result.get();
+    ASSERT_EQ(result.status, CallStatus::Replied);
+    EXPECT_EQ(replyNumber(result), -1);
+
+    // Only the untagged messages end up in the receive queues.
+    auto first = takeNumbered(server);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first->number(), 1);
+    auto second = takeNumbered(server);
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(second->number(), 3);
+    EXPECT_EQ(client.tryTakeNextMessage(), nullptr);
+}
+
+// The tag belongs to the frame queued by the call, not to every frame of the same message.
+TEST_F(RpcChannelTest, SameMessageSentPlainAndAsCall)
+{
+    std::promise<bool> plain_arrived_first;
+    server_channel.setRequestHandler(
+        [this, &plain_arrived_first](uint32_t call_id, const MessagePtr&)
+        {
+            plain_arrived_first.set_value(server.tryTakeNextMessage() != nullptr);
+            server_channel.reply(call_id, makeNumbered(-1));
+        });
+
+    const auto shared = makeNumbered(1);
+    ASSERT_TRUE(client.sendMessage(shared));
+    RpcChannel::Call call = client_channel.call(shared, std::chrono::milliseconds(10000));
+
+    EXPECT_TRUE(plain_arrived_first.get_future().get());
+    const CallResult result = call.result.get();
+    ASSERT_EQ(result.status, CallStatus::Replied);
+    EXPECT_EQ(replyNumber(result), -1);
+    EXPECT_EQ(server.tryTakeNextMessage(), nullptr);
+}
+
+// Without a request handler the request is dropped, so only the timeout ends the call.
+TEST_F(RpcChannelTest, UnansweredCallTimesOut)
+{
+    const auto start = std::chrono::steady_clock::now();
+    RpcChannel::Call call = client_channel.call(makeNumbered(1), std::chrono::milliseconds(100));
+
+    ASSERT_EQ(call.result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(call.result.get().status, CallStatus::TimedOut);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+    EXPECT_EQ(client_channel.getPendingCallCount(), 0u);
+}
+
+TEST_F(RpcChannelTest, CancelledCallIgnoresItsReply)
+{
+    std::promise<uint32_t> received;
+    server_channel.setRequestHandler([&received](uint32_t call_id, const MessagePtr&) { received.set_value(call_id); });
+
+    RpcChannel::Call call = client_channel.call(makeNumbered(1));
+    const uint32_t server_call_id = received.get_future().get();
+    EXPECT_TRUE(client_channel.cancel(call.id));
+    EXPECT_FALSE(client_channel.cancel(call.id));
+    EXPECT_EQ(call.result.get().status, CallStatus::Cancelled);
+
+    // The late reply neither completes anything nor ends up in the receive queue.
+    ASSERT_TRUE(server_channel.reply(server_call_id, makeNumbered(2)));
+    server_channel.setRequestHandler(nullptr);
+    RpcChannel::Call next = client_channel.call(makeNumbered(3), std::chrono::milliseconds(200));
+    EXPECT_EQ(next.result.get().status, CallStatus::TimedOut);
+    EXPECT_EQ(client.tryTakeNextMessage(), nullptr);
+}
+
+TEST_F(RpcChannelTest, CallsFailWhenTheConnectionCloses)
+{
+    std::promise<void> received;
+    server_channel.setRequestHandler([&received](uint32_t, const MessagePtr&) { received.set_value(); });
+
+    RpcChannel::Call call = client_channel.call(makeNumbered(1));
+    received.get_future().wait();
+    server.close();
+
+    ASSERT_EQ(call.result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(call.result.get().status, CallStatus::Failed);
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/Socket.h"
+#include "Arcus/SocketOptions.h"
+#include "TestUtils.h"
+
+using namespace Arcus;
+
+namespace
+{
+// Larger than the kernel buffers on both sides, so writing it blocks while the server does not read.
+constexpr std::size_t large_payload = 1024 * 1024;
+
+class SendCompletionTest : public SocketPairTest
+{
+protected:
+    void SetUp() override
+    {
+        // The server stops reading after every large message, until the test takes it.
+        SocketOptions server_options;
+        server_options.receive_buffer_size = 64 * 1024;
+        server_options.receive_high_water_mark = 16 * 1024;
+        server_options.receive_low_water_mark = 4 * 1024;
+        server.setOptions(server_options);
+
+        SocketOptions client_options;
+        client_options.send_buffer_size = 64 * 1024;
+        client.setOptions(client_options);
+
+        SocketPairTest::SetUp();
+    }
+
+    bool waitForPauses(uint64_t pauses)
+    {
+        return waitFor([this, pauses]() { return server.getStatistics().receive_pauses >= pauses; });
+    }
+};
+} // namespace
+
+// A message queued both untracked and tracked is only reported once the tracked frame was written.
+TEST_F(SendCompletionTest, SameMessageIsTrackedPerFrame)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    ASSERT_TRUE(client.sendMessage(makeNumbered(0, large_payload)));
+    ASSERT_TRUE(waitForPauses(1));
+
+    // The untracked frame goes out behind a message that cannot be written until the server reads again.
+    // Usually the worker takes both at once, otherwise the untracked frame is still queued.
+    const auto shared = makeNumbered(1);
+    ASSERT_TRUE(client.sendMessage(makeNumbered(2, large_payload)));
+    ASSERT_TRUE(client.sendMessage(shared));
+    ASSERT_TRUE(waitFor([this]() { return client.getStatistics().send_queue_depth < 2; }));
+    ASSERT_TRUE(client.sendMessage(makeNumbered(3, large_payload)));
+    std::future<SendReceipt> receipt = client.sendMessage(shared, SendCompletion::Written);
+
+    // Taking the first message lets the server read the untracked frame, while the tracked one waits behind the third message.
+    ASSERT_NE(takeNumbered(server), nullptr);
+    ASSERT_TRUE(waitForPauses(2));
+    EXPECT_EQ(receipt.wait_for(std::chrono::milliseconds(200)), std::future_status::timeout);
+
+    for (int number : { 2, 1, 3, 1 })
+    {
+        auto message = takeNumbered(server);
+        ASSERT_NE(message, nullptr);
+        ASSERT_EQ(message->number(), number);
+    }
+    ASSERT_EQ(receipt.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_TRUE(receipt.get().written);
+}
+
+TEST_F(SendCompletionTest, SendAfterCloseCompletesUnwritten)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    client.close();
+
+    std::future<SendReceipt> receipt = client.sendMessage(makeNumbered(1), SendCompletion::Written);
+    ASSERT_EQ(receipt.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_FALSE(receipt.get().written);
+}
+
+// Whether a send comes before or after the close, its receipt is completed.
+TEST_F(SendCompletionTest, SendsDuringCloseAllComplete)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+
+    std::vector<std::future<SendReceipt>> receipts;
+    std::thread sender(
+        [this, &receipts]()
+        {
+            for (int i = 0; i < 5000; ++i)
+            {
+                receipts.push_back(client.sendMessage(makeNumbered(i), SendCompletion::Written));
+            }
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    client.close();
+    sender.join();
+
+    for (auto& receipt : receipts)
+    {
+        ASSERT_EQ(receipt.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    }
+}
@@ -0,0 +1,199 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/Socket.h"
+#include "PlatformSocket_p.h"
+#include "TestUtils.h"
+
+using namespace Arcus;
+using Arcus::Private::PlatformSocket;
+
+namespace
+{
+/**
+ * Forwards one connection to a socket, and drops it once the client sent an amount of bytes.
+ *
+ * The connection is cut wherever the limit falls, usually in the middle of a frame, like
+ * a connection that is lost.
+ */
+class DroppingProxy
+{
+public:
+    ~DroppingProxy()
+    {
+        stopped = true;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+
+    /**
+     * \return The port to connect to, or 0 if the proxy could not listen.
+     */
+    uint16_t start(uint16_t target_port, std::size_t byte_limit)
+    {
+        for (int attempt = 0; attempt < 20; ++attempt)
+        {
+            const uint16_t port = nextTestPort();
+            if (listener.create() && listener.bind("127.0.0.1", port) && listener.listen(1))
+            {
+                thread = std::thread(&DroppingProxy::run, this, target_port, byte_limit);
+                return port;
+            }
+            listener.close();
+        }
+        return 0;
+    }
+
+private:
+    void run(uint16_t target_port, std::size_t byte_limit)
+    {
+        while (! stopped && ! listener.waitForReadable(10))
+        {
+        }
+        PlatformSocket client_side;
+        PlatformSocket server_side;
+        if (stopped || ! listener.acceptConnection(client_side) || ! server_side.create() || ! server_side.connect("127.0.0.1", target_port))
+        {
+            return;
+        }
+
+        PlatformSocket* sides[] = { &client_side, &server_side };
+        bool readable[2] = { false, false };
+        char buffer[4096];
+        std::size_t forwarded = 0;
+        while (! stopped && forwarded < byte_limit)
+        {
+            PlatformSocket::waitForAnyReadable(sides, 2, 10, readable);
+            for (std::size_t i = 0; i < 2; ++i)
+            {
+                if (! readable[i])
+                {
+                    continue;
+                }
+                const std::size_t size = i == 0 ? std::min(sizeof(buffer), byte_limit - forwarded) : sizeof(buffer);
+                const auto received = sides[i]->readBytes(size, buffer);
+                if (received <= 0 || sides[1 - i]->writeBytes(static_cast<std::size_t>(received), buffer) != received)
+                {
+                    stopped = true;
+                    break;
+                }
+                if (i == 0)
+                {
+                    forwarded += static_cast<std::size_t>(received);
+                }
+            }
+        }
+
+        for (PlatformSocket* side : sides)
+        {
+            side->shutdown(PlatformSocket::ShutdownDirection::ShutdownBoth);
+            side->close();
+        }
+    }
+
+    PlatformSocket listener;
+    std::thread thread;
+    std::atomic<bool> stopped { false };
+};
+
+bool isStopped(const Socket& socket)
+{
+    return socket.getState() == SocketState::Closed || socket.getState() == SocketState::Error;
+}
+
+class SessionResumeTest : public SocketPairTest
+{
+protected:
+    void SetUp() override
+    {
+        for (Socket* socket : { &server, &client })
+        {
+            socket->setSessionResume(true);
+        }
+        SocketPairTest::SetUp();
+    }
+
+    // Take the messages that are queued, checking that they continue where the earlier ones stopped.
+    void takeQueued(int& next_number)
+    {
+        while (auto message = std::dynamic_pointer_cast<arcus::test::Numbered>(server.tryTakeNextMessage()))
+        {
+            ASSERT_EQ(message->number(), next_number);
+            ++next_number;
+        }
+    }
+};
+} // namespace
+
+TEST_F(SessionResumeTest, ResendsWhatTheDroppedConnectionLost)
+{
+    const uint16_t server_port = listenOnLoopback(server);
+    ASSERT_NE(server_port, 0);
+    DroppingProxy proxy;
+    const uint16_t proxy_port = proxy.start(server_port, 20000);
+    ASSERT_NE(proxy_port, 0);
+    client.connect("127.0.0.1", proxy_port);
+    ASSERT_TRUE(waitForState(client, SocketState::Connected));
+    ASSERT_TRUE(waitForState(server, SocketState::Connected));
+
+    constexpr int message_count = 3000;
+    for (int i = 0; i < message_count; ++i)
+    {
+        ASSERT_TRUE(client.sendMessage(makeNumbered(i, 32)));
+    }
+
+    ASSERT_TRUE(waitFor([this]() { return isStopped(server) && isStopped(client); }));
+    int next_number = 0;
+    takeQueued(next_number);
+    ASSERT_LT(next_number, message_count) << "The connection was not dropped before everything arrived";
+
+    server.reset();
+    client.reset();
+    ASSERT_TRUE(connectSockets(server, client));
+
+    // Whatever arrived before the drop is not sent again, and nothing else is missing.
+    ASSERT_TRUE(waitFor(
+        [this, &next_number]()
+        {
+            takeQueued(next_number);
+            return next_number == message_count || HasFatalFailure();
+        }));
+    EXPECT_EQ(next_number, message_count);
+}
+
+TEST_F(SessionResumeTest, CloseStartsANewSession)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(client.sendMessage(makeNumbered(i)));
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        auto message = takeNumbered(server);
+        ASSERT_NE(message, nullptr);
+        ASSERT_EQ(message->number(), i);
+    }
+
+    client.close();
+    ASSERT_TRUE(waitFor([this]() { return isStopped(server); }));
+    server.close();
+    server.reset();
+    client.reset();
+    ASSERT_TRUE(connectSockets(server, client));
+
+    // Nothing of the closed session is sent again.
+    ASSERT_TRUE(client.sendMessage(makeNumbered(100)));
+    auto message = takeNumbered(server);
+    ASSERT_NE(message, nullptr);
+    EXPECT_EQ(message->number(), 100);
+}
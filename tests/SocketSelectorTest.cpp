@@ -0,0 +1,62 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <chrono>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/RpcChannel.h"
+#include "Arcus/Socket.h"
+#include "Arcus/SocketSelector.h"
+#include "TestUtils.h"
+
+using namespace Arcus;
+
+namespace
+{
+class SocketSelectorTest : public SocketPairTest
+{
+protected:
+    void SetUp() override
+    {
+        SocketPairTest::SetUp();
+        ASSERT_TRUE(connectSockets(server, client));
+        ASSERT_TRUE(selector.addSocket(&server));
+    }
+
+    SocketSelector selector;
+};
+} // namespace
+
+TEST_F(SocketSelectorTest, ReceivedMessageWakesTheSelector)
+{
+    ASSERT_TRUE(client.sendMessage(makeNumbered(1)));
+
+    const std::vector<Socket*> ready = selector.waitFor(std::chrono::seconds(10));
+    ASSERT_EQ(ready.size(), 1u);
+    EXPECT_EQ(ready.front(), &server);
+    auto message = takeNumbered(server, std::chrono::milliseconds(0));
+    ASSERT_NE(message, nullptr);
+    EXPECT_EQ(message->number(), 1);
+}
+
+TEST_F(SocketSelectorTest, ClosedSocketWakesTheSelector)
+{
+    client.close();
+
+    const std::vector<Socket*> ready = selector.waitFor(std::chrono::seconds(10));
+    ASSERT_EQ(ready.size(), 1u);
+    EXPECT_EQ(ready.front(), &server);
+}
+
+// A call to a socket without an RPC channel is dropped with only a debug message, which is nothing to wake up for.
+TEST_F(SocketSelectorTest, DebugMessageDoesNotWakeTheSelector)
+{
+    RpcChannel client_channel(client);
+    client_channel.call(makeNumbered(1), std::chrono::milliseconds(100));
+
+    EXPECT_TRUE(selector.waitFor(std::chrono::milliseconds(500)).empty());
+    EXPECT_EQ(server.getLastError().getErrorCode(), ErrorCode::Debug);
+    EXPECT_EQ(server.tryTakeNextMessage(), nullptr);
+}
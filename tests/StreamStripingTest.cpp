@@ -0,0 +1,95 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/Socket.h"
+#include "Arcus/SocketOptions.h"
+#include "TestUtils.h"
+
+using namespace Arcus;
+
+namespace
+{
+class StreamStripingTest : public SocketPairTest
+{
+protected:
+    void SetUp() override
+    {
+        for (Socket* socket : { &server, &client })
+        {
+            socket->setStreamCount(4);
+        }
+        SocketPairTest::SetUp();
+    }
+};
+} // namespace
+
+// Frames go out over whichever stream is next, so they can overtake each other on the way.
+TEST_F(StreamStripingTest, MessagesArriveInSendOrder)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+
+    constexpr int message_count = 2000;
+    for (int i = 0; i < message_count; ++i)
+    {
+        // Mix small and large frames, so the large ones are still being read while small ones arrive on other streams.
+        ASSERT_TRUE(client.sendMessage(makeNumbered(i, i % 10 == 0 ? 64 * 1024 : i % 100)));
+    }
+
+    for (int i = 0; i < message_count; ++i)
+    {
+        auto message = takeNumbered(server);
+        ASSERT_NE(message, nullptr) << "Message " << i << " did not arrive";
+        ASSERT_EQ(message->number(), i);
+        EXPECT_EQ(message->payload().size(), static_cast<std::size_t>(i % 10 == 0 ? 64 * 1024 : i % 100));
+    }
+}
+
+TEST_F(StreamStripingTest, BothDirectionsKeepTheirOrder)
+{
+    server.setOptions(SocketOptions::bulkThroughput());
+    client.setOptions(SocketOptions::lowLatency());
+    ASSERT_TRUE(connectSockets(server, client));
+
+    constexpr int message_count = 500;
+    for (int i = 0; i < message_count; ++i)
+    {
+        ASSERT_TRUE(client.sendMessage(makeNumbered(i, 1024)));
+        ASSERT_TRUE(server.sendMessage(makeNumbered(-i, 1024)));
+    }
+
+    for (int i = 0; i < message_count; ++i)
+    {
+        auto request = takeNumbered(server);
+        ASSERT_NE(request, nullptr);
+        ASSERT_EQ(request->number(), i);
+
+        auto answer = takeNumbered(client);
+        ASSERT_NE(answer, nullptr);
+        ASSERT_EQ(answer->number(), -i);
+    }
+}
+
+// Each stream carries a close request of its own, the close only completes once all of them arrived.
+TEST_F(StreamStripingTest, CloseReachesTheOtherSideAfterTheLastMessage)
+{
+    ASSERT_TRUE(connectSockets(server, client));
+
+    constexpr int message_count = 100;
+    for (int i = 0; i < message_count; ++i)
+    {
+        ASSERT_TRUE(client.sendMessage(makeNumbered(i, 4096)));
+    }
+    client.close();
+
+    EXPECT_TRUE(waitForState(server, SocketState::Closed));
+    for (int i = 0; i < message_count; ++i)
+    {
+        auto message = takeNumbered(server, std::chrono::milliseconds(1000));
+        ASSERT_NE(message, nullptr) << "Message " << i << " was lost in the close";
+        EXPECT_EQ(message->number(), i);
+    }
+}
@@ -0,0 +1,154 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+#ifndef ARCUS_TEST_UTILS_H
+#define ARCUS_TEST_UTILS_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "Arcus/Socket.h"
+#include "TestMessages.pb.h"
+
+/**
+ * \return A loopback port that no earlier test in this process used.
+ *
+ * Every test runs in a process of its own, so the ports start at a random offset to keep
+ * tests that run after each other from waiting for ports in TIME_WAIT.
+ */
+inline uint16_t nextTestPort()
+{
+    static uint16_t next_port = static_cast<uint16_t>(30000 + std::random_device()() % 20000);
+    return next_port++;
+}
+
+/**
+ * Wait until a condition holds.
+ *
+ * \return true if it held before the timeout expired, false if not.
+ */
+inline bool waitFor(const std::function<bool()>& condition, std::chrono::milliseconds timeout = std::chrono::milliseconds(10000))
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (! condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/**
+ * Wait until a socket reaches a state.
+ *
+ * \return true if it did before the timeout expired, false if not.
+ */
+inline bool waitForState(const Arcus::Socket& socket, Arcus::SocketState state, std::chrono::milliseconds timeout = std::chrono::milliseconds(10000))
+{
+    return waitFor([&socket, state]() { return socket.getState() == state; }, timeout);
+}
+
+/**
+ * Let a socket listen on a loopback port, trying the next port when one is in use.
+ *
+ * \return The port the socket listens on, or 0 if it could not listen.
+ */
+inline uint16_t listenOnLoopback(Arcus::Socket& server)
+{
+    for (int attempt = 0; attempt < 20; ++attempt)
+    {
+        const uint16_t port = nextTestPort();
+        server.listen("127.0.0.1", port);
+        waitFor([&server]() { return server.getState() == Arcus::SocketState::Listening || server.getState() == Arcus::SocketState::Error; });
+        if (server.getState() == Arcus::SocketState::Listening)
+        {
+            return port;
+        }
+        server.reset();
+    }
+    return 0;
+}
+
+/**
+ * Connect two sockets over the loopback interface.
+ *
+ * \return true if both are connected, false if not.
+ */
+inline bool connectSockets(Arcus::Socket& server, Arcus::Socket& client)
+{
+    const uint16_t port = listenOnLoopback(server);
+    if (port == 0)
+    {
+        return false;
+    }
+    client.connect("127.0.0.1", port);
+    return waitForState(server, Arcus::SocketState::Connected) && waitForState(client, Arcus::SocketState::Connected);
+}
+
+/**
+ * Create a numbered message with a payload of some size.
+ */
+inline std::shared_ptr<arcus::test::Numbered> makeNumbered(int number, std::size_t payload_size = 0)
+{
+    auto message = std::make_shared<arcus::test::Numbered>();
+    message->set_number(number);
+    message->set_payload(std::string(payload_size, static_cast<char>('a' + number % 26)));
+    return message;
+}
+
+/**
+ * Take the next message of a socket, as a numbered message.
+ *
+ * \return The message, or nullptr if none arrived before the timeout or it was of another type.
+ */
+inline std::shared_ptr<arcus::test::Numbered> takeNumbered(Arcus::Socket& socket, std::chrono::milliseconds timeout = std::chrono::milliseconds(10000))
+{
+    Arcus::MessagePtr message;
+    waitFor(
+        [&socket, &message]()
+        {
+            message = socket.tryTakeNextMessage();
+            return message != nullptr;
+        },
+        timeout);
+    return std::dynamic_pointer_cast<arcus::test::Numbered>(message);
+}
+
+/**
+ * Fixture with a server and a client socket that both know the numbered message.
+ *
+ * Both sockets are closed after the test. Fixtures that need other settings apply them
+ * before calling SetUp() of this class.
+ */
+class SocketPairTest : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        for (Arcus::Socket* socket : { &server, &client })
+        {
+            socket->registerMessageType<arcus::test::Numbered>();
+        }
+    }
+
+    void TearDown() override
+    {
+        client.close();
+        server.close();
+    }
+
+    Arcus::Socket server;
+    Arcus::Socket client;
+};
+
+#endif // ARCUS_TEST_UTILS_H
@@ -0,0 +1,407 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+// Pushes generated traffic through a pair of sockets connected over the loopback interface
+// and reports throughput, latency and the CPU time spent per message.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Arcus/Socket.h"
+#include "LoadMessages.pb.h"
+
+using namespace Arcus;
+
+namespace
+{
+/**
+ * The sizes of the payloads to send.
+ *
+ * Either a single size, a range from which sizes are drawn log-uniformly so every
+ * order of magnitude gets the same share, or a weighted mix of sizes.
+ */
+class SizeDistribution
+{
+public:
+    /**
+     * \param spec "1024", "64-65536" or "64:90,65536:10".
+     *
+     * \return false if the specification could not be parsed.
+     */
+    bool parse(const std::string& spec)
+    {
+        sizes.clear();
+        weights.clear();
+        minimum = maximum = 0;
+
+        const std::size_t dash = spec.find('-');
+        if (dash != std::string::npos)
+        {
+            minimum = std::strtoull(spec.substr(0, dash).c_str(), nullptr, 10);
+            maximum = std::strtoull(spec.substr(dash + 1).c_str(), nullptr, 10);
+            return minimum > 0 && minimum <= maximum;
+        }
+
+        std::size_t start = 0;
+        while (start < spec.size())
+        {
+            std::size_t end = spec.find(',', start);
+            if (end == std::string::npos)
+            {
+                end = spec.size();
+            }
+            const std::string entry = spec.substr(start, end - start);
+            const std::size_t colon = entry.find(':');
+            sizes.push_back(std::strtoull(entry.substr(0, colon).c_str(), nullptr, 10));
+            weights.push_back(colon == std::string::npos ? 1.0 : std::atof(entry.substr(colon + 1).c_str()));
+            start = end + 1;
+        }
+        if (sizes.empty() || *std::min_element(weights.begin(), weights.end()) <= 0.0)
+        {
+            return false;
+        }
+        pick = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+        return true;
+    }
+
+    std::size_t next(std::mt19937& random)
+    {
+        if (sizes.empty())
+        {
+            std::uniform_real_distribution<double> exponent(std::log(static_cast<double>(minimum)), std::log(static_cast<double>(maximum)));
+            return static_cast<std::size_t>(std::exp(exponent(random)));
+        }
+        return sizes[pick(random)];
+    }
+
+    std::size_t largest() const
+    {
+        return sizes.empty() ? maximum : *std::max_element(sizes.begin(), sizes.end());
+    }
+
+private:
+    std::vector<std::size_t> sizes;
+    std::vector<double> weights;
+    std::discrete_distribution<std::size_t> pick;
+    std::size_t minimum = 0;
+    std::size_t maximum = 0;
+};
+
+struct Arguments
+{
+    SizeDistribution sizes;
+    unsigned producers = 1;
+    double rate = 0.0;
+    unsigned burst = 1;
+    double duration = 5.0;
+    std::size_t messages = 0;
+    std::size_t window = 10000;
+    std::string profile;
+    bool duplex = false;
+    uint16_t port = 47200;
+};
+
+void printUsage()
+{
+    std::cerr << "Usage: arcus_load [options]\n"
+                 "\n"
+                 "  --sizes <spec>       Payload sizes in bytes: a single size such as 1024, a range such as 64-65536\n"
+                 "                       drawn log-uniformly, or a weighted mix such as 64:90,65536:10 (default 1024).\n"
+                 "  --producers <count>  Threads sending messages through the same socket (default 1).\n"
+                 "  --rate <count>       Messages per second sent by each producer, 0 for as fast as possible (default 0).\n"
+                 "  --burst <count>      Send this many messages back to back, keeping the average rate (default 1).\n"
+                 "  --duration <s>       How long to send, in seconds (default 5).\n"
+                 "  --messages <count>   Stop after sending this many messages in total instead.\n"
+                 "  --window <count>     The most messages that are sent but not yet received (default 10000).\n"
+                 "  --profile <profile>  Socket options to use: default, low-latency or bulk (default default).\n"
+                 "  --duplex             Read and write the connections on separate threads.\n"
+                 "  --port <port>        Loopback port to use (default 47200).\n";
+}
+
+bool parseArguments(int argc, char** argv, Arguments& arguments)
+{
+    if (! arguments.sizes.parse("1024"))
+    {
+        return false;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (argument == "--sizes" && has_value)
+        {
+            if (! arguments.sizes.parse(argv[++i]))
+            {
+                return false;
+            }
+        }
+        else if (argument == "--producers" && has_value)
+        {
+            arguments.producers = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (argument == "--rate" && has_value)
+        {
+            arguments.rate = std::max(0.0, std::atof(argv[++i]));
+        }
+        else if (argument == "--burst" && has_value)
+        {
+            arguments.burst = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (argument == "--duration" && has_value)
+        {
+            arguments.duration = std::atof(argv[++i]);
+        }
+        else if (argument == "--messages" && has_value)
+        {
+            arguments.messages = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (argument == "--window" && has_value)
+        {
+            arguments.window = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--profile" && has_value)
+        {
+            arguments.profile = argv[++i];
+            if (arguments.profile != "default" && arguments.profile != "low-latency" && arguments.profile != "bulk")
+            {
+                return false;
+            }
+        }
+        else if (argument == "--duplex")
+        {
+            arguments.duplex = true;
+        }
+        else if (argument == "--port" && has_value)
+        {
+            arguments.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+SocketOptions socketOptions(const Arguments& arguments)
+{
+    SocketOptions options = SocketOptions::defaults();
+    if (arguments.profile == "low-latency")
+    {
+        options = SocketOptions::lowLatency();
+    }
+    else if (arguments.profile == "bulk")
+    {
+        options = SocketOptions::bulkThroughput();
+    }
+    options.duplex_threads = arguments.duplex;
+    return options;
+}
+
+// The CPU time used by all threads of this process, both ends of the connection included.
+std::chrono::microseconds processCpuTime()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (! GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return std::chrono::microseconds(0);
+    }
+    const auto ticks = [](const FILETIME& time) { return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    return std::chrono::microseconds((ticks(kernel) + ticks(user)) / 10);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return std::chrono::microseconds(0);
+    }
+    const auto time = [](const timeval& value) { return std::chrono::seconds(value.tv_sec) + std::chrono::microseconds(value.tv_usec); };
+    return std::chrono::duration_cast<std::chrono::microseconds>(time(usage.ru_utime) + time(usage.ru_stime));
+#endif
+}
+
+uint64_t steadyNow()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool waitForState(const Socket& socket, SocketState state)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (socket.getState() != state)
+    {
+        if (std::chrono::steady_clock::now() > deadline || socket.getState() == SocketState::Error)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+double percentile(const std::vector<uint64_t>& sorted, double percentile)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    const std::size_t index = std::min(sorted.size() - 1, static_cast<std::size_t>(percentile / 100.0 * static_cast<double>(sorted.size())));
+    return static_cast<double>(sorted[index]) / 1000.0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Arguments arguments;
+    if (! parseArguments(argc, argv, arguments))
+    {
+        printUsage();
+        return 2;
+    }
+
+    Socket receiver;
+    Socket sender;
+    for (Socket* socket : { &receiver, &sender })
+    {
+        socket->registerMessageType<arcus::load::Load>();
+        socket->setOptions(socketOptions(arguments));
+    }
+    receiver.listen("127.0.0.1", arguments.port);
+    if (! waitForState(receiver, SocketState::Listening) && receiver.getState() != SocketState::Connected)
+    {
+        std::cerr << "Could not listen on port " << arguments.port << ": " << receiver.getLastError().getErrorMessage() << "\n";
+        return 1;
+    }
+    sender.connect("127.0.0.1", arguments.port);
+    if (! waitForState(receiver, SocketState::Connected) || ! waitForState(sender, SocketState::Connected))
+    {
+        std::cerr << "Could not connect over the loopback interface: " << sender.getLastError().getErrorMessage() << "\n";
+        return 1;
+    }
+
+    std::atomic<std::size_t> sent(0);
+    std::atomic<std::size_t> received(0);
+    std::atomic<bool> sending_done(false);
+
+    // Latencies in nanoseconds, only touched by the receiving thread until it is joined.
+    std::vector<uint64_t> latencies;
+    latencies.reserve(1 << 20);
+    std::size_t received_bytes = 0;
+    std::thread receiving(
+        [&]()
+        {
+            while (! sending_done || received < sent)
+            {
+                auto message = std::dynamic_pointer_cast<arcus::load::Load>(receiver.takeNextMessage());
+                if (! message)
+                {
+                    // The socket was closed, since a spurious wake up of an open socket waits again.
+                    break;
+                }
+                latencies.push_back(steadyNow() - message->sent_time());
+                received_bytes += message->ByteSizeLong();
+                ++received;
+            }
+        });
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto stop = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(arguments.duration));
+    const auto cpu_start = processCpuTime();
+
+    // Each producer sends bursts of messages, spaced to keep its average rate.
+    const std::string filler(arguments.sizes.largest(), 'x');
+    std::vector<std::thread> producers;
+    for (unsigned producer = 0; producer < arguments.producers; ++producer)
+    {
+        producers.emplace_back(
+            [&, producer]()
+            {
+                std::mt19937 random(producer + 1);
+                SizeDistribution sizes = arguments.sizes;
+                const std::size_t quota = arguments.messages / arguments.producers + (producer < arguments.messages % arguments.producers ? 1 : 0);
+                const auto burst_interval = arguments.rate > 0.0 ? std::chrono::duration<double>(arguments.burst / arguments.rate) : std::chrono::duration<double>(0.0);
+
+                std::size_t count = 0;
+                for (std::size_t burst = 0;; ++burst)
+                {
+                    if (arguments.rate > 0.0)
+                    {
+                        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(burst_interval * static_cast<double>(burst)));
+                    }
+                    for (unsigned i = 0; i < arguments.burst; ++i)
+                    {
+                        if (arguments.messages > 0 ? count >= quota : std::chrono::steady_clock::now() >= stop)
+                        {
+                            return;
+                        }
+                        while (sent - received >= arguments.window && sender.getState() == SocketState::Connected)
+                        {
+                            std::this_thread::yield();
+                        }
+
+                        auto message = std::make_shared<arcus::load::Load>();
+                        message->set_producer(producer);
+                        message->set_payload(filler.data(), sizes.next(random));
+                        message->set_sent_time(steadyNow());
+                        ++sent;
+                        if (! sender.sendMessage(message))
+                        {
+                            --sent;
+                            return;
+                        }
+                        ++count;
+                    }
+                }
+            });
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+    sending_done = true;
+
+    // Give what is still underway the time to arrive, then unblock the receiver if it is waiting for more.
+    const auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (received < sent && std::chrono::steady_clock::now() < drain_deadline && receiver.getState() == SocketState::Connected)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto cpu_time = processCpuTime() - cpu_start;
+    sender.close();
+    receiver.close();
+    receiving.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    const std::size_t delivered = received;
+    const double cpu_per_message = delivered > 0 ? static_cast<double>(cpu_time.count()) / static_cast<double>(delivered) : 0.0;
+
+    std::printf("Sent %zu messages, received %zu in %.3f s\n", sent.load(), delivered, elapsed);
+    std::printf("Throughput: %.0f messages/s, %.1f MB/s\n", static_cast<double>(delivered) / elapsed, static_cast<double>(received_bytes) / 1e6 / elapsed);
+    std::printf(
+        "Latency (us): p50 %.1f, p99 %.1f, p999 %.1f, max %.1f\n",
+        percentile(latencies, 50),
+        percentile(latencies, 99),
+        percentile(latencies, 99.9),
+        latencies.empty() ? 0.0 : static_cast<double>(latencies.back()) / 1000.0);
+    std::printf("CPU time: %.3f s, %.2f us per message for both ends\n", static_cast<double>(cpu_time.count()) / 1e6, cpu_per_message);
+    return delivered == sent ? 0 : 1;
+}
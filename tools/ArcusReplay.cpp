@@ -0,0 +1,269 @@
+// Copyright (c) 2025 UltiMaker
+// libArcus is released under the terms of the LGPLv3 or higher.
+
+// Feeds the frames of a capture, see Socket::setCapture(), through a pair of sockets
+// connected over the loopback interface and reports throughput and latency.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <google/protobuf/message.h>
+
+#include "Arcus/MessageTypeStore.h"
+#include "Arcus/Socket.h"
+#include "CaptureFile_p.h"
+
+using namespace Arcus;
+using Arcus::Private::CapturedFrame;
+using Arcus::Private::CaptureReader;
+
+namespace
+{
+struct Arguments
+{
+    std::string capture;
+    std::string proto;
+    std::string descriptor_set;
+    CapturedFrame::Direction direction = CapturedFrame::Direction::Received;
+    bool fast = false;
+    int repeat = 1;
+    uint16_t port = 47100;
+};
+
+struct Frame
+{
+    std::chrono::nanoseconds time;
+    MessagePtr message;
+    std::size_t size;
+};
+
+void printUsage()
+{
+    std::cerr << "Usage: arcus_replay <capture> (--proto <file> | --descriptor-set <file>) [options]\n"
+                 "\n"
+                 "  --proto <file>           Protocol file describing the captured messages.\n"
+                 "  --descriptor-set <file>  Precompiled descriptor set describing the captured messages.\n"
+                 "  --direction <direction>  Replay the frames the capturing socket 'received' (default) or 'sent'.\n"
+                 "  --fast                   Send as fast as possible instead of at the original timing.\n"
+                 "  --repeat <count>         Replay the capture this many times (default 1).\n"
+                 "  --port <port>            Loopback port to use (default 47100).\n";
+}
+
+bool parseArguments(int argc, char** argv, Arguments& arguments)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (argument == "--proto" && has_value)
+        {
+            arguments.proto = argv[++i];
+        }
+        else if (argument == "--descriptor-set" && has_value)
+        {
+            arguments.descriptor_set = argv[++i];
+        }
+        else if (argument == "--direction" && has_value)
+        {
+            const std::string direction = argv[++i];
+            if (direction != "received" && direction != "sent")
+            {
+                return false;
+            }
+            arguments.direction = direction == "sent" ? CapturedFrame::Direction::Sent : CapturedFrame::Direction::Received;
+        }
+        else if (argument == "--fast")
+        {
+            arguments.fast = true;
+        }
+        else if (argument == "--repeat" && has_value)
+        {
+            arguments.repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (argument == "--port" && has_value)
+        {
+            arguments.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+        else if (arguments.capture.empty() && argument.rfind("--", 0) != 0)
+        {
+            arguments.capture = argument;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return ! arguments.capture.empty() && (arguments.proto.empty() != arguments.descriptor_set.empty());
+}
+
+bool waitForState(const Socket& socket, SocketState state)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (socket.getState() != state)
+    {
+        if (std::chrono::steady_clock::now() > deadline || socket.getState() == SocketState::Error)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+std::chrono::microseconds percentile(const std::vector<std::chrono::nanoseconds>& sorted, double percentile)
+{
+    if (sorted.empty())
+    {
+        return std::chrono::microseconds(0);
+    }
+    const std::size_t index = std::min(sorted.size() - 1, static_cast<std::size_t>(percentile / 100.0 * static_cast<double>(sorted.size())));
+    return std::chrono::duration_cast<std::chrono::microseconds>(sorted[index]);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Arguments arguments;
+    if (! parseArguments(argc, argv, arguments))
+    {
+        printUsage();
+        return 2;
+    }
+
+    // Both sockets look up types in the same store.
+    auto store = std::make_shared<MessageTypeStore>();
+    const bool registered = arguments.proto.empty() ? store->registerAllMessageTypesFromDescriptorSet(arguments.descriptor_set) : store->registerAllMessageTypes(arguments.proto);
+    if (! registered)
+    {
+        std::cerr << "Could not register the message types:\n" << store->getErrorMessages();
+        return 1;
+    }
+    store->freeze();
+
+    CaptureReader reader;
+    if (! reader.open(arguments.capture))
+    {
+        std::cerr << "Could not read capture " << arguments.capture << "\n";
+        return 1;
+    }
+
+    std::vector<Frame> frames;
+    std::size_t unknown_frames = 0;
+    CapturedFrame captured;
+    while (reader.next(captured))
+    {
+        if (captured.direction != arguments.direction)
+        {
+            continue;
+        }
+
+        MessagePtr message = store->createMessage(captured.type_id);
+        if (! message || ! message->ParseFromString(captured.payload))
+        {
+            ++unknown_frames;
+            continue;
+        }
+        frames.push_back({ captured.time, message, captured.payload.size() });
+    }
+    if (frames.empty())
+    {
+        std::cerr << "The capture has no frames to replay in this direction\n";
+        return 1;
+    }
+
+    Socket receiver;
+    Socket sender;
+    receiver.setMessageTypeStore(store);
+    sender.setMessageTypeStore(store);
+    receiver.listen("127.0.0.1", arguments.port);
+    sender.connect("127.0.0.1", arguments.port);
+    if (! waitForState(receiver, SocketState::Connected) || ! waitForState(sender, SocketState::Connected))
+    {
+        std::cerr << "Could not connect over the loopback interface: " << sender.getLastError().getErrorMessage() << receiver.getLastError().getErrorMessage() << "\n";
+        return 1;
+    }
+
+    const std::size_t total = frames.size() * static_cast<std::size_t>(arguments.repeat);
+    std::vector<std::chrono::steady_clock::time_point> send_times(total);
+    std::vector<std::chrono::steady_clock::time_point> receive_times(total);
+
+    // A single connection delivers in order, so the nth message received is the nth sent.
+    std::atomic<std::size_t> received(0);
+    std::thread receiving(
+        [&]()
+        {
+            const auto deadline_after_silence = std::chrono::seconds(10);
+            auto last_progress = std::chrono::steady_clock::now();
+            while (received < total && receiver.getState() == SocketState::Connected)
+            {
+                if (receiver.tryTakeNextMessage())
+                {
+                    receive_times[received] = std::chrono::steady_clock::now();
+                    last_progress = receive_times[received];
+                    ++received;
+                }
+                else if (std::chrono::steady_clock::now() - last_progress > deadline_after_silence)
+                {
+                    break;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t sent = 0;
+    std::size_t bytes = 0;
+    for (int round = 0; round < arguments.repeat; ++round)
+    {
+        const auto round_start = std::chrono::steady_clock::now();
+        for (const Frame& frame : frames)
+        {
+            if (! arguments.fast)
+            {
+                std::this_thread::sleep_until(round_start + (frame.time - frames.front().time));
+            }
+            send_times[sent++] = std::chrono::steady_clock::now();
+            bytes += frame.size;
+            sender.sendMessage(frame.message);
+        }
+    }
+
+    receiving.join();
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const std::size_t delivered = received;
+
+    std::vector<std::chrono::nanoseconds> latencies;
+    latencies.reserve(delivered);
+    for (std::size_t i = 0; i < delivered; ++i)
+    {
+        latencies.push_back(receive_times[i] - send_times[i]);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    const SocketStatistics statistics = receiver.getStatistics();
+
+    std::printf("Replayed %zu of %zu messages (%zu frames skipped), %.1f MB in %.3f s\n", delivered, total, unknown_frames, static_cast<double>(bytes) / 1e6, elapsed);
+    std::printf("Throughput: %.0f messages/s, %.1f MB/s\n", static_cast<double>(delivered) / elapsed, static_cast<double>(bytes) / 1e6 / elapsed);
+    std::printf(
+        "Latency (us): p50 %lld, p90 %lld, p99 %lld, max %lld\n",
+        static_cast<long long>(percentile(latencies, 50).count()),
+        static_cast<long long>(percentile(latencies, 90).count()),
+        static_cast<long long>(percentile(latencies, 99).count()),
+        static_cast<long long>(latencies.empty() ? 0 : std::chrono::duration_cast<std::chrono::microseconds>(latencies.back()).count()));
+    std::printf("Parse time (us): mean %lld, p99 %lld\n", static_cast<long long>(statistics.parse_time.mean().count()), static_cast<long long>(statistics.parse_time.percentile(99).count()));
+
+    sender.close();
+    receiver.close();
+    return delivered == total ? 0 : 1;
+}